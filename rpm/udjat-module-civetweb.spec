@@ -45,6 +45,8 @@ BuildRequires:	gcc-c++
 BuildRequires:	pkgconfig(libudjat)
 BuildRequires:	pkgconfig(pugixml)
 BuildRequires:	pkgconfig(libssl)
+BuildRequires:	pkgconfig(zlib)
+BuildRequires:	pkgconfig(libzstd)
 BuildRequires:	civetweb-devel >= 1.15
 BuildRequires:	gettext-devel
 BuildRequires:	make
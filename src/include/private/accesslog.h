@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the asynchronous access log.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <memory>
+ #include <vector>
+ #include <list>
+ #include <string>
+ #include <cstdint>
+ #include <cstdio>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Access log written by a background thread from per-thread ring buffers.
+		class UDJAT_PRIVATE AccessLog {
+		public:
+
+			/// @brief Log entry, fixed size to avoid allocations on the request thread.
+			struct Entry {
+				enum : uint8_t {
+					Access,		///< @brief Request has finished.
+					Message		///< @brief Civetweb message.
+				} type = Access;
+
+				int status = 0;
+				time_t when = 0;
+				uint64_t bytes = 0;
+				uint64_t usec = 0;
+				char client[48];
+				char method[12];
+				char text[256];		///< @brief The request uri or the message.
+			};
+
+		private:
+
+			/// @brief Single producer, single consumer ring.
+			struct Ring {
+				std::vector<Entry> entries;
+				size_t mask;
+				std::atomic<size_t> head{0};		///< @brief Next write (producer).
+				std::atomic<size_t> tail{0};		///< @brief Next read (consumer).
+				std::atomic<bool> closed{false};	///< @brief Owner thread has finished.
+
+				Ring(size_t size) : entries(size), mask{size-1} {
+				}
+			};
+
+			std::mutex guard;
+			std::condition_variable cond;
+
+			/// @brief Rings of the request threads.
+			std::list<std::shared_ptr<Ring>> rings;
+
+			/// @brief Messages from the other threads (or from a full ring), under the guard.
+			std::list<std::pair<time_t,std::string>> messages;
+
+			/// @brief Entries by ring (power of 2).
+			size_t size = 1024;
+
+			/// @brief Log one in 'sample' requests (messages are always logged).
+			unsigned int sample = 1;
+
+			/// @brief Log requests?
+			bool requests = false;
+
+			/// @brief Interval between drains (milliseconds).
+			unsigned int interval = 250;
+
+			/// @brief Output file (nullptr for stderr).
+			FILE *file = nullptr;
+
+			std::thread *writer = nullptr;
+			std::atomic<bool> enabled{false};
+
+			struct {
+				std::atomic<uint64_t> queued{0};
+				std::atomic<uint64_t> written{0};
+				std::atomic<uint64_t> dropped{0};	///< @brief Requests lost on full rings.
+				std::atomic<uint64_t> batches{0};
+			} counters;
+
+			AccessLog();
+
+			/// @brief Get (or register) the current thread ring, only for request threads.
+			Ring & ring();
+
+			/// @brief Get an entry to fill on the current thread ring.
+			/// @return The entry or nullptr if the ring is full.
+			Entry * reserve() noexcept;
+
+			/// @brief Publish the reserved entry.
+			void commit() noexcept;
+
+			/// @brief Drain all rings.
+			void drain();
+
+		public:
+			static AccessLog & getInstance();
+
+			~AccessLog();
+
+			/// @brief Load the configuration, start the writer.
+			void setup();
+
+			/// @brief Flush the pending entries, stop the writer.
+			void stop();
+
+			/// @brief Request has started on this thread (it's a request thread).
+			static void begin() noexcept;
+
+			/// @brief Are the requests logged?
+			inline bool logged() const noexcept {
+				return enabled && requests;
+			}
+
+			/// @brief Log a civetweb message, never dropped.
+			void push(const char *message) noexcept;
+
+			/// @brief Request has finished, log it.
+			void push(const struct mg_connection *conn, int status, uint64_t bytes) noexcept;
+
+			/// @brief Get log counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
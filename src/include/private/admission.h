@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the admission controller.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <list>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Limit the requests in flight, reject the excess with '503 Service Unavailable'.
+		class UDJAT_PRIVATE Admission {
+		public:
+
+			/// @brief Concurrency limit for a path prefix.
+			struct Route {
+				std::string path;
+				std::atomic<unsigned int> limit{0};
+				std::atomic<unsigned int> active{0};
+				std::atomic<uint64_t> rejected{0};
+
+				Route(const char *p, unsigned int l) : path{p}, limit{l} {
+				}
+			};
+
+		private:
+			std::mutex guard;
+
+			/// @brief Routes, longest path first.
+			std::list<Route> routes;
+
+			/// @brief Global in-flight cap (0 = unlimited).
+			unsigned int max = 0;
+
+			/// @brief Time waiting for a request slot (milliseconds, 0 = unlimited).
+			unsigned int budget = 0;
+
+			/// @brief Value for the Retry-After header.
+			unsigned int retry = 1;
+
+			std::atomic<unsigned int> active{0};
+
+			struct {
+				std::atomic<uint64_t> admitted{0};
+				std::atomic<uint64_t> global{0};	///< @brief Rejected by the global cap.
+				std::atomic<uint64_t> route{0};		///< @brief Rejected by route limits.
+				std::atomic<uint64_t> queue{0};		///< @brief Rejected by the queue time budget.
+			} counters;
+
+			Admission();
+
+			/// @brief Send the '503 Service Unavailable' response.
+			int reject(struct mg_connection *conn) noexcept;
+
+		public:
+			static Admission & getInstance();
+
+			/// @brief Load the configuration.
+			void setup();
+
+			/// @brief Set the concurrency limit for path (0 removes the limit).
+			void set(const char *path, unsigned int limit);
+
+			/// @brief Admit request, reserve request thread slot.
+			/// @return 0 if the request was admitted, the HTTP status if it was rejected.
+			int enter(struct mg_connection *conn) noexcept;
+
+			/// @brief Request has finished, release the resources reserved by enter().
+			void leave() noexcept;
+
+			/// @brief Get admission counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
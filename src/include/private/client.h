@@ -0,0 +1,290 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the outbound HTTP/1.1 client sessions.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/civetweb.h>
+ #include <private/decoder.h>
+ #include <atomic>
+ #include <mutex>
+ #include <chrono>
+ #include <memory>
+ #include <list>
+ #include <map>
+ #include <vector>
+ #include <string>
+ #include <cstdint>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+#endif // _WIN32
+
+#ifdef HAVE_LIBSSL
+	#include <openssl/ssl.h>
+#endif // HAVE_LIBSSL
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Connection to a HTTP server (plain socket or TLS).
+		class UDJAT_PRIVATE Session {
+		private:
+
+#ifdef _WIN32
+			SOCKET sock = INVALID_SOCKET;
+#else
+			int sock = -1;
+#endif // _WIN32
+
+#ifdef HAVE_LIBSSL
+			SSL *ssl = nullptr;
+#endif // HAVE_LIBSSL
+
+			/// @brief Received but not consumed.
+			char buffer[8192];
+			size_t offset = 0;
+			size_t length = 0;
+
+			/// @brief Wait for the socket, throws on timeout.
+			void wait(bool output);
+
+			/// @brief Read from the socket or the TLS layer.
+			size_t recv(void *data, size_t length);
+
+		public:
+
+			/// @brief Pool key (scheme://host:port).
+			const std::string key;
+
+			/// @brief I/O timeout.
+			std::chrono::milliseconds timeout;
+
+			/// @brief Released to the pool at.
+			std::chrono::steady_clock::time_point idle;
+
+			/// @brief Requests sent on this session.
+			unsigned int requests = 0;
+
+			/// @brief Connection phases (dns, connect and tls).
+			Timing timing;
+
+			/// @brief Connect to server.
+			Session(const char *scheme, const char *hostname, unsigned int port);
+			~Session();
+
+			Session(const Session &) = delete;
+			Session & operator=(const Session &) = delete;
+
+#ifdef HAVE_LIBSSL
+			/// @brief The client TLS context.
+			static SSL_CTX * context();
+
+			/// @brief Set the server name (SNI) and the name expected on the certificate.
+			/// @param hostname The host name or IP address from the URL.
+			static void expect(SSL *ssl, const char *hostname);
+#endif // HAVE_LIBSSL
+
+			/// @brief Check if an idle session can be reused (not closed by the server, nothing pending).
+			bool alive() noexcept;
+
+			/// @brief Send data.
+			void write(const void *data, size_t length);
+
+			/// @brief Receive data.
+			/// @return Number of bytes, 0 when the server has closed the connection.
+			size_t read(void *data, size_t length);
+
+			/// @brief Receive a line, without the CRLF.
+			/// @return false if the server has closed the connection.
+			bool getline(std::string &line);
+
+		};
+
+		/// @brief Idle keep-alive sessions by scheme, host and port.
+		class UDJAT_PRIVATE SessionPool {
+		private:
+			std::mutex guard;
+
+			/// @brief Idle sessions by key, most recently used last.
+			std::map<std::string,std::list<Session *>> sessions;
+
+			/// @brief Idle sessions.
+			size_t count = 0;
+
+			/// @brief Limits, enabled and max_requests are also read without the guard.
+			struct {
+				std::atomic<bool> enabled{true};
+				size_t max_idle = 32;				///< @brief Idle sessions.
+				size_t max_host = 4;				///< @brief Idle sessions by host.
+				std::atomic<unsigned int> max_requests{100};	///< @brief Requests by session.
+				std::chrono::seconds timeout{30};	///< @brief Idle timeout.
+			} limits;
+
+			struct {
+				std::atomic<uint64_t> created{0};
+				std::atomic<uint64_t> reused{0};
+				std::atomic<uint64_t> expired{0};
+				std::atomic<uint64_t> stale{0};
+				std::atomic<uint64_t> discarded{0};
+			} counters;
+
+			SessionPool();
+
+			/// @brief Remove expired sessions, the guard must be locked.
+			void expire(const std::chrono::steady_clock::time_point &now);
+
+		public:
+			static SessionPool & getInstance();
+			~SessionPool();
+
+			/// @brief Load the configuration.
+			void setup();
+
+			/// @brief Is keep-alive enabled?
+			inline bool enabled() const noexcept {
+				return limits.enabled;
+			}
+
+			/// @brief Get an idle session or connect to server.
+			/// @param reused Set to true when the session came from the pool.
+			std::unique_ptr<Session> get(const char *scheme, const char *hostname, unsigned int port, bool &reused);
+
+			/// @brief Keep the session for the next request to the same server.
+			void put(std::unique_ptr<Session> session) noexcept;
+
+			/// @brief Close all idle sessions.
+			void clear() noexcept;
+
+			/// @brief Get pool counters.
+			void get(Udjat::Value &value);
+
+		};
+
+		/// @brief HTTP/1.1 request and response on a pooled session.
+		class UDJAT_PRIVATE Client {
+		private:
+			std::unique_ptr<Session> session;
+
+			/// @brief Response without body (HEAD, 1xx, 204, 304).
+			bool empty = false;
+
+			/// @brief The session can be reused after the body.
+			bool keepalive = false;
+
+			/// @brief Body is chunked.
+			bool chunked = false;
+
+			/// @brief Body bytes left on the current chunk or content (-1 until close).
+			long long remaining = -1;
+
+			/// @brief All body bytes were read.
+			bool complete = false;
+
+			/// @brief The server has closed (or reset) the session before any response byte.
+			bool closed = false;
+
+			/// @brief Content decoder (nullptr for identity).
+			std::unique_ptr<Decoder> decoder;
+
+			/// @brief Largest decoded body ('http-client/max-decoded', 0 for no limit).
+			unsigned long long limit = 0;
+
+			/// @brief Encoded data, not decoded.
+			std::vector<char> encoded;
+			size_t position = 0;
+			size_t available = 0;
+
+			/// @brief Send request, read the response headers.
+			void exchange(const std::string &request);
+
+			/// @brief Read the body as sent by the server.
+			size_t receive(void *data, size_t length);
+
+		public:
+
+			/// @brief Response status.
+			int status = 0;
+
+			/// @brief Response status text.
+			std::string text;
+
+			/// @brief Content length (-1 if unknown or decoded).
+			long long length = -1;
+
+			/// @brief Body as sent by the server.
+			struct {
+				long long length = -1;				///< @brief Content-Length (-1 if unknown).
+				unsigned long long received = 0;	///< @brief Received bytes.
+			} wire;
+
+			/// @brief Decoded bytes (only with a decoder).
+			unsigned long long decoded = 0;
+
+			/// @brief Response headers.
+			std::list<std::pair<std::string,std::string>> headers;
+
+			/// @brief Connection and request phases (the body is timed by the reader).
+			Timing timing;
+
+			/// @brief Connect to server, send the request and read the response headers.
+			/// @param scheme The URL scheme.
+			/// @param hostname The server name.
+			/// @param port The server port.
+			/// @param request The request (line, headers and payload).
+			/// @param head true if it's a HEAD request (the response has no body).
+			Client(const char *scheme, const char *hostname, unsigned int port, const std::string &request, bool head = false);
+
+			/// @brief Return the session to the pool if the body was read.
+			~Client();
+
+			/// @brief Get response header.
+			/// @return The header value or nullptr.
+			const char * header(const char *name) const noexcept;
+
+			/// @brief Decode the response body.
+			/// @param encoding The Content-Encoding value.
+			void decode(const char *encoding);
+
+			/// @brief Is the response body decoded?
+			inline bool decoding() const noexcept {
+				return (bool) decoder;
+			}
+
+			/// @brief Read response body (decoded).
+			/// @return Number of bytes, 0 at the end of the body.
+			size_t read(void *data, size_t length);
+
+			/// @brief Parse a chunk size line (hex digits, then extensions or the end of the line).
+			/// @return The chunk size, 0 for the last chunk.
+			/// @exception std::system_error EBADMSG if the line isn't a chunk size.
+			static long long chunksize(const char *line);
+
+		};
+
+	}
+
+ }
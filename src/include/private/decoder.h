@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the client content decoders.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <memory>
+ #include <cstddef>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Streamed Content-Encoding decoder.
+		class UDJAT_PRIVATE Decoder {
+		public:
+
+			/// @brief The Accept-Encoding value for the available decoders (empty if none).
+			static const char * accepted() noexcept;
+
+			/// @brief Build decoder.
+			/// @param encoding The Content-Encoding value.
+			/// @return The decoder, nullptr for the identity encoding.
+			static std::unique_ptr<Decoder> factory(const char *encoding);
+
+			virtual ~Decoder();
+
+			/// @brief Decode data.
+			/// @param input The encoded data, advanced by the consumed bytes.
+			/// @param available Encoded bytes, decremented by the consumed bytes.
+			/// @param output The buffer for the decoded data.
+			/// @param length The buffer size.
+			/// @return Number of decoded bytes, can be 0 while the input is consumed.
+			virtual size_t decode(const char * &input, size_t &available, char *output, size_t length) = 0;
+
+			/// @brief Is the end of the encoded stream reached?
+			virtual bool finished() const noexcept = 0;
+
+		};
+
+	}
+
+ }
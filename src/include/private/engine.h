@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the multiplexed client engine.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <thread>
+ #include <chrono>
+ #include <functional>
+ #include <memory>
+ #include <list>
+ #include <vector>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		class Worker;
+
+		/// @brief Run many client requests from one thread (epoll).
+		class UDJAT_PRIVATE Engine {
+		public:
+
+			/// @brief Request result.
+			using Result = CivetWeb::Result;
+
+			using Callback = std::function<void(const Result &result)>;
+
+			struct Request;
+
+		private:
+			std::mutex guard;
+
+			/// @brief Requests waiting for the engine thread.
+			std::list<std::shared_ptr<Request>> queue;
+
+			std::thread *thread = nullptr;
+			bool running = false;
+
+			/// @brief epoll and wakeup descriptors.
+			int epfd = -1;
+			int evfd = -1;
+
+			struct {
+				std::atomic<uint64_t> started{0};
+				std::atomic<uint64_t> completed{0};
+				std::atomic<uint64_t> failed{0};
+				std::atomic<uint64_t> timeouts{0};
+				std::atomic<unsigned int> active{0};
+			} counters;
+
+			Engine();
+
+			/// @brief Start the engine thread (if not started).
+			void start();
+
+			/// @brief Engine thread.
+			void run();
+
+			/// @brief Build the request from the worker.
+			std::shared_ptr<Request> prepare(Worker &worker, const Callback &callback, const std::chrono::milliseconds &timeout);
+
+			/// @brief Queue request.
+			void push(std::shared_ptr<Request> request);
+
+			/// @brief Deliver the result.
+			void finish(std::shared_ptr<Request> request) noexcept;
+
+		public:
+			static Engine & getInstance();
+			~Engine();
+
+			/// @brief Stop the engine, pending requests fail with ECANCELED.
+			void stop();
+
+			/// @brief Start the worker request.
+			/// @param worker The worker with url, method, payload and request headers.
+			/// @param callback Called on the main loop when finished.
+			/// @param timeout Request timeout (0 for the http/timeout value).
+			void push(Worker &worker, const Callback &callback, const std::chrono::milliseconds &timeout = std::chrono::milliseconds{0});
+
+			/// @brief Get the urls concurrently.
+			/// @param urls The urls to get.
+			/// @param timeout Timeout for each request (0 for the http/timeout value).
+			/// @return Results in the order of the urls, after all are finished.
+			std::vector<Result> get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout = std::chrono::milliseconds{0});
+
+			/// @brief Get engine counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the client response cache (RFC 9111, private cache).
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <atomic>
+ #include <mutex>
+ #include <memory>
+ #include <list>
+ #include <map>
+ #include <string>
+ #include <cstdint>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Cached GET responses, in memory and (optionally) on disk.
+		class UDJAT_PRIVATE HttpCache {
+		public:
+
+			/// @brief Cached response, never changed after stored.
+			struct Entry {
+				std::string url;
+				int status = 200;
+				std::string text;
+				std::list<std::pair<std::string,std::string>> headers;
+				std::string body;
+
+				time_t response_time = 0;		///< @brief When the response was received.
+				time_t initial_age = 0;			///< @brief Age when received (Age and Date headers).
+				time_t lifetime = 0;			///< @brief Freshness lifetime.
+				bool revalidate = false;		///< @brief 'no-cache', always revalidate.
+
+				/// @brief Get response header.
+				const char * header(const char *name) const noexcept;
+
+				/// @brief Can be used without revalidation?
+				bool fresh(time_t now) const noexcept;
+
+				/// @brief Set the freshness from the response headers.
+				/// @param heuristic Use the Last-Modified age when there's no explicit lifetime.
+				void update(time_t request_time, time_t now, bool heuristic);
+
+			};
+
+		private:
+			mutable std::mutex guard;
+
+			/// @brief Memory tier, most recently used first.
+			std::list<std::shared_ptr<const Entry>> entries;
+			std::map<std::string,std::list<std::shared_ptr<const Entry>>::iterator> index;
+			size_t used = 0;
+
+			/// @brief Limits, the path is read under the guard (see directory()).
+			struct {
+				std::atomic<bool> enabled{false};
+				std::atomic<bool> heuristic{false};		///< @brief Heuristic freshness (RFC 9111 4.2.2).
+				size_t memory = 8388608;				///< @brief Memory tier size.
+				std::atomic<size_t> entry{1048576};		///< @brief Largest cached body.
+				std::string path;						///< @brief Disk tier, empty to disable.
+			} limits;
+
+			struct {
+				std::atomic<uint64_t> hits{0};
+				std::atomic<uint64_t> disk{0};			///< @brief Hits loaded from disk.
+				std::atomic<uint64_t> revalidated{0};	///< @brief Not modified responses.
+				std::atomic<uint64_t> misses{0};
+				std::atomic<uint64_t> stored{0};
+				std::atomic<uint64_t> evicted{0};
+			} counters;
+
+			HttpCache();
+
+			/// @brief Insert in the memory tier, the guard must be locked.
+			void insert(std::shared_ptr<const Entry> entry);
+
+			/// @brief Remove the disk tier files above the memory tier size, the guard must be locked.
+			void trim() noexcept;
+
+			/// @brief Disk tier path (empty if disabled).
+			std::string directory() const;
+
+			/// @brief Disk file for the url.
+			static std::string filename(const std::string &path, const std::string &url);
+
+			std::shared_ptr<const Entry> load(const std::string &url) const;
+			void save(const Entry &entry) const noexcept;
+
+		public:
+			static HttpCache & getInstance();
+
+			/// @brief Load the configuration.
+			void setup();
+
+			inline bool enabled() const noexcept {
+				return limits.enabled;
+			}
+
+			/// @brief Can a body of this size be cached?
+			inline bool fits(size_t length) const noexcept {
+				return length <= limits.entry;
+			}
+
+			/// @brief Get cached response (fresh or not).
+			std::shared_ptr<const Entry> find(const std::string &url);
+
+			/// @brief Count a fresh response served from the cache.
+			inline void hit() noexcept {
+				counters.hits++;
+			}
+
+			/// @brief Store response if cacheable.
+			/// @param request_time When the request was sent.
+			void store(std::shared_ptr<Entry> entry, time_t request_time);
+
+			/// @brief Update the cached response from a 304.
+			/// @return The updated entry.
+			std::shared_ptr<const Entry> refresh(std::shared_ptr<const Entry> entry, const std::list<std::pair<std::string,std::string>> &headers, time_t request_time);
+
+			/// @brief Drop the cached response.
+			void remove(const std::string &url) noexcept;
+
+			/// @brief Drop the memory tier.
+			void clear() noexcept;
+
+			/// @brief Get cache counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
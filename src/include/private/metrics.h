@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the request metrics.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <list>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Request counters and latency histograms by route.
+		class UDJAT_PRIVATE Metrics {
+		public:
+
+			/// @brief The routes with metrics, one for each handler.
+			enum Route : unsigned int {
+				Root,
+				Custom,
+				Product,
+				Icon,
+				Image,
+
+				RouteCount
+			};
+
+			/// @brief Status classes (1xx to 5xx, 0 for unexpected codes).
+			static const unsigned int StatusCount = 6;
+
+			/// @brief Histogram buckets.
+			///
+			/// Log-linear buckets in microseconds, 4 sub-buckets for each power
+			/// of 2 (max error 25%); values above the last bucket are clamped.
+			static const unsigned int BucketCount = 112;
+
+		private:
+
+			/// @brief Counters for one route.
+			struct Counters {
+				std::atomic<uint64_t> requests{0};
+				std::atomic<uint64_t> status[StatusCount];
+				std::atomic<uint64_t> received{0};		///< @brief Request body bytes.
+				std::atomic<uint64_t> sent{0};			///< @brief Response body bytes.
+				std::atomic<uint64_t> sum{0};			///< @brief Total latency (microseconds).
+				std::atomic<uint64_t> buckets[BucketCount];
+
+				Counters();
+			};
+
+			/// @brief Per-thread counters, updated only by the owner thread.
+			struct Shard {
+				Counters routes[RouteCount];
+			};
+
+			std::mutex guard;
+
+			/// @brief Shards of the running threads.
+			std::list<Shard *> shards;
+
+			/// @brief Counters from the finished threads.
+			Shard retired;
+
+			Metrics();
+
+			/// @brief Get (or register) the current thread counters.
+			Shard & shard();
+
+			/// @brief Merge counters.
+			static void merge(Counters &to, const Counters &from) noexcept;
+
+		public:
+			static Metrics & getInstance();
+
+			/// @brief Get histogram bucket for value.
+			/// @param usec Latency in microseconds.
+			static unsigned int bucket(uint64_t usec) noexcept;
+
+			/// @brief Get the upper limit (exclusive) of the bucket in microseconds.
+			static uint64_t limit(unsigned int bucket) noexcept;
+
+			/// @brief Handler for route has started on this thread.
+			static void begin(const Route route) noexcept;
+
+			/// @brief Add response body bytes to the current request.
+			static void sent(uint64_t bytes) noexcept;
+
+			/// @brief Get the response body bytes of the current request.
+			static uint64_t sent() noexcept;
+
+			/// @brief Don't record the current request.
+			static void cancel() noexcept;
+
+			/// @brief Request has finished, record it on the route of the current thread.
+			void end(const struct mg_connection *conn, int status) noexcept;
+
+			/// @brief Get metrics in prometheus text format.
+			std::string to_string();
+
+		};
+
+	}
+
+ }
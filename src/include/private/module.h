@@ -34,7 +34,9 @@
  #include <udjat/civetweb.h>
  #include <iostream>
  #include <list>
+ #include <memory>
  #include <cstring>
+ #include <private/client.h>
 
  using namespace Udjat;
  using namespace std;
@@ -57,7 +59,9 @@
 			int send(const Abstract::Response &response) const noexcept override;
 
 			int send(const char *mime_type, const char *response, size_t length) const noexcept override;
+			int send(const char *mime_type, const char *response, size_t length, const char *etag) const noexcept override;
 			int send(const HTTP::Method method, const char *filename, bool allow_index, const char *mime_type, unsigned int max_age) const override;
+			int accepted(const char *location) const noexcept override;
 
 			inline struct mg_connection * connection() {
 				return conn;
@@ -91,16 +95,42 @@
 		};
 
 		/// @brief CivetWeb protocol worker.
-		class Worker : public Udjat::Protocol::Worker {
+		class Worker : public Udjat::Protocol::Worker, public CivetWeb::Timed {
 		private:
+			friend class Engine;
 
 			struct {
 				std::list<Header> request;
 				std::list<Header> response;
 			} headers;
 
-			/// @brief Connect to server, send request.
-			struct mg_connection * connect();
+			/// @brief Phases of the last request.
+			Timing timing;
+
+			/// @brief Build the request (line, headers and payload).
+			std::string build(const URL::Components &components);
+
+			/// @brief Connect to server, send request, read the response headers.
+			std::unique_ptr<Client> connect();
+
+			/// @brief Download the body in parallel ranges.
+			/// @param client The full body response, used for the first range.
+			/// @param fd The output file.
+			/// @param count The number of ranges.
+			void segments(Client &client, int fd, unsigned int count, const std::function<bool(double current, double total)> &progress);
+
+			/// @brief Remove request header.
+			void unset(const char *name) noexcept;
+
+			/// @brief Has the request credentials (Authorization or Cookie, including the default headers)?
+			bool credentials() const;
+
+			/// @brief Get request header.
+			/// @return The header value, nullptr if not set or empty.
+			const char * requested(const char *name) const noexcept;
+
+			/// @brief Replace the response headers.
+			void replace(const std::list<std::pair<std::string,std::string>> &response);
 
 		public:
 			Worker(const char *url = "", const HTTP::Method method = HTTP::Get, const char *payload = "");
@@ -108,6 +138,10 @@
 			Udjat::String get(const std::function<bool(double current, double total)> &progress) override;
 			int test(const std::function<bool(double current, double total)> &progress) noexcept override;
 
+			const Timing & timings() const noexcept override {
+				return timing;
+			}
+
 			bool save(const char *filename, const std::function<bool(double current, double total)> &progress, bool replace) override;
 
 			Protocol::Header & request(const char *name) override;
@@ -153,6 +187,50 @@
  /// @brief Handler for '/' request.
  int rootWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
 
+ /// @brief Handler for pending responses.
+ int pendingWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
+
+ /// @brief Handler for request pool and admission counters.
+ int poolWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
+
+ /// @brief Handler for the slow request journal.
+ int slowWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
+
+ /// @brief Handler for the agent snapshot.
+ int snapshotWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
+
+ /// @brief Handler for prometheus metrics.
+ int metricsWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
+
+ /// @brief Websocket handlers for agent updates.
+ int agentWebSocketConnect(const struct mg_connection *conn, void *cbdata);
+ void agentWebSocketReady(struct mg_connection *conn, void *cbdata);
+ int agentWebSocketData(struct mg_connection *conn, int bits, char *data, size_t length, void *cbdata);
+ void agentWebSocketClose(const struct mg_connection *conn, void *cbdata);
+
+ /// @brief The request will be idle for a long time, release its admission slot and
+ ///        exclude it from the metrics, timing and slow request journal.
+ /// @details The request keeps its civetweb thread; a request writing a full
+ ///          response afterwards must be admitted again.
+ void park_request() noexcept;
+
+ /// @brief Check if the client accepts 'text/event-stream'.
+ bool accepts_event_stream(struct mg_connection *conn) noexcept;
+
+ /// @brief Stream the agent changes as server-sent events.
+ /// @param path The agent path.
+ int agentEventStream(struct mg_connection *conn, const char *path) noexcept;
+
+ /// @brief Long poll, wait for agent changes if the request has '?wait=<seconds>'.
+ /// @param path The agent path.
+ /// @return 0 to send the agent response, the HTTP status if the request was rejected.
+ int agentWait(struct mg_connection *conn, const char *path);
+
+ /// @brief Send the agents changed after '?since=<version>'.
+ /// @param path The agent path.
+ /// @return 0 if the request has no 'since' argument, the HTTP status if the response was sent.
+ int agentDelta(struct mg_connection *conn, const char *path) noexcept;
+
  /// @brief Handler for '/favicon.ico' request.
  int faviconWebHandler(struct mg_connection *conn, void *cbdata) noexcept;
 
@@ -167,8 +245,24 @@
  /// @brief Send response.
  int send(struct mg_connection *conn, const Abstract::Response &response) noexcept;
 
+ /// @brief Add header to the response of the current thread (sent by ::send).
+ void add_response_header(const char *name, const char *value);
+
+ /// @brief Request has finished, remove the extra headers.
+ void clear_response_headers() noexcept;
+
  /// @brief Send error page.
  int http_error(struct mg_connection *conn, int code, const char *message) noexcept;
 
  /// @brief Send error page.
  int http_error(struct mg_connection *conn, int code, const char *message, const char *body) noexcept;
+
+ /// @brief Check an 'If-None-Match' header (RFC 9110 13.1.2, weak comparison).
+ /// @param header The If-None-Match value: '*' or a list of entity tags.
+ /// @param etag The current entity tag.
+ /// @return true if the tag matches (the response is '304 Not Modified').
+ bool etag_match(const char *header, const char *etag) noexcept;
+
+ /// @brief Can the client read the status pages (metrics, pool and slow requests)?
+ /// @return true if the client address is on 'civetweb/status-allow'.
+ bool status_allowed(struct mg_connection *conn) noexcept;
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the request pool controller.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <chrono>
+ #include <list>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Track request threads, limit the active handlers (not the civetweb threads).
+		class UDJAT_PRIVATE Pool {
+		public:
+
+			/// @brief Per-thread accounting.
+			struct Thread {
+				unsigned int id = 0;
+				uint64_t requests = 0;
+				uint64_t busy = 0;		///< @brief Busy time (microseconds).
+				std::chrono::steady_clock::time_point started;
+			};
+
+		private:
+			std::mutex guard;
+			std::condition_variable cond;
+
+			/// @brief Concurrency limit is enabled?
+			bool limited = false;
+
+			/// @brief Next thread id.
+			unsigned int ids = 0;
+
+			/// @brief Bounds for the active handler limit.
+			unsigned int min = 4;
+			unsigned int max = 50;
+
+			/// @brief Interval between sizing decisions.
+			std::chrono::milliseconds interval{1000};
+
+			/// @brief The current limit for active handlers.
+			unsigned int limit = 50;
+
+			/// @brief Requests running.
+			unsigned int active = 0;
+
+			/// @brief Requests waiting for a slot.
+			unsigned int waiting = 0;
+
+			/// @brief Peak of active requests since the last decision.
+			unsigned int peak = 0;
+
+			std::chrono::steady_clock::time_point decision;
+
+			struct {
+				uint64_t requests = 0;
+				uint64_t queued = 0;		///< @brief Requests that had to wait for a slot.
+				uint64_t wait = 0;			///< @brief Total time waiting for a slot (microseconds).
+				unsigned int max_waiting = 0;
+				unsigned int max_active = 0;
+				uint64_t grow = 0;			///< @brief Decisions increasing the limit.
+				uint64_t shrink = 0;		///< @brief Decisions reducing the limit.
+				uint64_t expired = 0;		///< @brief Requests that exceeded the queue time budget.
+			} counters;
+
+			std::list<Thread *> threads;
+
+			Pool();
+
+			/// @brief Get (or register) the current thread accounting.
+			Thread & thread();
+
+			/// @brief Update limit, must be called with the guard locked.
+			void adjust(const std::chrono::steady_clock::time_point &now);
+
+		public:
+			static Pool & getInstance();
+
+			/// @brief Load the configuration.
+			/// @param threads The civetweb thread count.
+			void setup(unsigned int threads);
+
+			/// @brief Is the concurrency limit enabled?
+			inline bool enabled() const noexcept {
+				return limited;
+			}
+
+			/// @brief Request has started, wait for a slot if the concurrency limit is enabled.
+			/// @param budget Maximum time waiting for a slot (milliseconds, 0 = no limit).
+			/// @return false if the budget has expired without a slot.
+			bool begin(unsigned int budget = 0) noexcept;
+
+			/// @brief Request has finished, release slot.
+			void end() noexcept;
+
+			/// @brief Get pool counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the per-client rate limiter.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <chrono>
+ #include <list>
+ #include <vector>
+ #include <string>
+ #include <unordered_map>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Token bucket rate limiter keyed by client address and route prefix.
+		class UDJAT_PRIVATE RateLimiter {
+		public:
+
+			/// @brief Rate limit for a path prefix.
+			struct Route {
+				std::string path;
+				double rate = 1;		///< @brief Tokens per second.
+				double burst = 1;		///< @brief Bucket size.
+				std::atomic<uint64_t> limited{0};
+
+				Route(const char *p, double r, double b) : path{p}, rate{r}, burst{b} {
+				}
+			};
+
+		private:
+
+			struct Bucket {
+				double tokens = 0;
+				std::chrono::steady_clock::time_point updated;
+				std::list<std::string>::iterator lru;
+			};
+
+			/// @brief Bucket shard, each one with its own lock.
+			struct Shard {
+				std::mutex guard;
+				std::unordered_map<std::string,Bucket> buckets;
+				std::list<std::string> lru;		///< @brief Most recently used first.
+			};
+
+			static const size_t nshards = 16;
+			Shard shards[nshards];
+
+			/// @brief Buckets by shard.
+			size_t capacity = 1024;
+
+			/// @brief Limited routes, longest path first.
+			std::list<Route> routes;
+
+			struct {
+				std::atomic<uint64_t> limited{0};
+				std::atomic<uint64_t> evicted{0};
+			} counters;
+
+			RateLimiter();
+
+		public:
+			static RateLimiter & getInstance();
+
+			/// @brief Load the configuration.
+			void setup();
+
+			/// @brief Check the request rate.
+			/// @return 0 if the request is allowed, the HTTP status if it was rejected.
+			int check(struct mg_connection *conn) noexcept;
+
+			/// @brief Get rate limiter counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
@@ -54,6 +54,10 @@
 			/// @brief The client address.
 			String address() const override;
 
+			/// @brief Get the client address (from X-Forwarded-For if available).
+			/// @param info The civetweb request info.
+			static String address(const struct mg_request_info *info);
+
 			String cookie(const char *name) const override;
 
 		};
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the client name resolution cache.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <atomic>
+ #include <mutex>
+ #include <thread>
+ #include <chrono>
+ #include <memory>
+ #include <vector>
+ #include <map>
+ #include <string>
+ #include <cstdint>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+#endif // _WIN32
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Cached getaddrinfo() results by host and port.
+		class UDJAT_PRIVATE Resolver {
+		public:
+
+			/// @brief Resolved address.
+			struct Address {
+				struct sockaddr_storage addr;
+				socklen_t length = 0;
+				int family = 0;
+				int socktype = 0;
+				int protocol = 0;
+			};
+
+			using Addresses = std::shared_ptr<const std::vector<Address>>;
+
+		private:
+			std::mutex guard;
+
+			struct Entry {
+				std::chrono::steady_clock::time_point expires;
+				Addresses addresses;		///< @brief Resolved addresses (empty on failure).
+				std::string message;		///< @brief Resolution error (negative entry).
+			};
+
+			/// @brief Entries by host:port.
+			std::map<std::string,Entry> entries;
+
+			struct {
+				bool enabled = true;
+				std::chrono::seconds ttl{60};			///< @brief Positive entries.
+				std::chrono::seconds negative{5};		///< @brief Failed resolutions.
+				size_t max_entries = 256;
+			} limits;
+
+			struct {
+				std::atomic<uint64_t> hits{0};
+				std::atomic<uint64_t> misses{0};
+				std::atomic<uint64_t> negative{0};		///< @brief Hits on failed resolutions.
+				std::atomic<uint64_t> failures{0};
+				std::atomic<uint64_t> evicted{0};
+			} counters;
+
+			/// @brief Thread resolving the 'pre-resolve' urls.
+			std::thread *preresolver = nullptr;
+			std::atomic<bool> stopping{false};
+
+			Resolver();
+
+			/// @brief Call getaddrinfo().
+			static Entry lookup(const char *hostname, unsigned int port);
+
+			/// @brief Drop expired entries and, if still full, the one expiring first; the guard must be locked.
+			void expire(const std::chrono::steady_clock::time_point &now);
+
+		public:
+			static Resolver & getInstance();
+			~Resolver();
+
+			/// @brief Load the configuration, pre-resolve the configured hosts.
+			void setup();
+
+			/// @brief Wait for the pre-resolve thread.
+			void stop();
+
+			/// @brief Resolve server name.
+			/// @return The server addresses (never empty).
+			Addresses resolve(const char *hostname, unsigned int port);
+
+			/// @brief Drop entry (the server wasn't reachable on any of the addresses).
+			void forget(const char *hostname, unsigned int port) noexcept;
+
+			/// @brief Drop all entries.
+			void clear() noexcept;
+
+			/// @brief Get cache counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
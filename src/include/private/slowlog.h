@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the slow request journal.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <udjat/tools/http/timing.h>
+ #include <civetweb.h>
+ #include <atomic>
+ #include <mutex>
+ #include <deque>
+ #include <string>
+ #include <cstdint>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Keep the last requests above the time threshold.
+		class UDJAT_PRIVATE SlowLog {
+		private:
+
+			struct Entry {
+				time_t when = 0;
+				std::string method;
+				std::string uri;
+				std::string client;
+				std::string worker;
+				int status = 0;
+				uint64_t bytes = 0;
+				uint64_t usec = 0;
+				uint64_t stages[HTTP::Timing::StageCount];
+			};
+
+			std::mutex guard;
+
+			/// @brief Slow requests, newest last.
+			std::deque<Entry> entries;
+
+			/// @brief Journal size.
+			size_t size = 64;
+
+			/// @brief Threshold (microseconds).
+			uint64_t threshold = 1000000;
+
+			std::atomic<uint64_t> count{0};
+
+			SlowLog();
+
+		public:
+			static SlowLog & getInstance();
+
+			/// @brief Load the configuration.
+			void setup();
+
+			/// @brief Timed request has finished, register it if above the threshold.
+			void push(const struct mg_connection *conn, int status, uint64_t bytes) noexcept;
+
+			/// @brief Get the journal.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the client TLS session cache.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/value.h>
+ #include <atomic>
+ #include <mutex>
+ #include <chrono>
+ #include <map>
+ #include <string>
+ #include <cstdint>
+
+#ifdef HAVE_LIBSSL
+	#include <openssl/ssl.h>
+#endif // HAVE_LIBSSL
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Last TLS session (or ticket) by server, to resume the handshake on new connections.
+		class UDJAT_PRIVATE TLSCache {
+		private:
+			std::mutex guard;
+
+#ifdef HAVE_LIBSSL
+			struct Entry {
+				SSL_SESSION *session = nullptr;
+				std::chrono::steady_clock::time_point stored;
+			};
+
+			/// @brief Sessions by scheme://host:port.
+			std::map<std::string,Entry> sessions;
+
+			/// @brief SSL ex_data index for the server key.
+			int index = -1;
+
+			/// @brief OpenSSL callback for new sessions and tickets.
+			static int store(SSL *ssl, SSL_SESSION *session);
+#endif // HAVE_LIBSSL
+
+			struct {
+				bool enabled = true;
+				size_t max_entries = 64;
+			} limits;
+
+			struct {
+				std::atomic<uint64_t> full{0};
+				std::atomic<uint64_t> resumed{0};
+				std::atomic<uint64_t> offered{0};		///< @brief Handshakes with a cached session.
+				std::atomic<uint64_t> stored{0};
+			} counters;
+
+			TLSCache();
+
+		public:
+			static TLSCache & getInstance();
+			~TLSCache();
+
+			/// @brief Load the configuration.
+			void setup();
+
+#ifdef HAVE_LIBSSL
+			/// @brief Enable client session caching on the context.
+			void attach(SSL_CTX *ctx);
+
+			/// @brief Offer the cached session for the server, before SSL_connect.
+			/// @param key The server key (scheme://host:port).
+			void prepare(SSL *ssl, const std::string &key);
+
+			/// @brief Count the finished handshake.
+			void handshake(SSL *ssl) noexcept;
+#endif // HAVE_LIBSSL
+
+			/// @brief Drop the session for the server (handshake failed).
+			void forget(const std::string &key) noexcept;
+
+			/// @brief Drop all sessions.
+			void clear() noexcept;
+
+			/// @brief Get handshake counters.
+			void get(Udjat::Value &value);
+
+		};
+
+	}
+
+ }
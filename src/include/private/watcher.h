@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the agent change watcher.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <functional>
+ #include <memory>
+ #include <chrono>
+ #include <list>
+ #include <map>
+ #include <deque>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace CivetWeb {
+
+		/// @brief Track the agent tree, give each change a version and a serialized frame.
+		class UDJAT_PRIVATE Watcher {
+		public:
+
+			/// @brief Agent state as seen by the last scan.
+			struct Agent {
+				std::string name;
+				std::string path;
+				std::string level;
+				std::string value;
+				std::string summary;
+
+				/// @brief Version of the last change.
+				uint64_t version = 0;
+
+				/// @brief Compact JSON document for this agent, shared by all outputs.
+				std::shared_ptr<const std::string> frame;
+
+				/// @brief Found on the current scan.
+				bool seen = false;
+			};
+
+			/// @brief Agent change.
+			struct Change {
+				uint64_t version = 0;
+				std::string path;
+				std::shared_ptr<const std::string> frame;
+			};
+
+			using Listener = std::function<void(const Change &change)>;
+
+		private:
+			std::mutex guard;
+
+			/// @brief Held while calling the listeners, unsubscribe() waits for it.
+			std::mutex notify;
+
+			/// @brief Agents by path.
+			std::map<std::string,Agent> agents;
+
+			/// @brief The last version.
+			uint64_t version = 0;
+
+			/// @brief Start time (microseconds), the versions restart with the service.
+			const uint64_t epoch;
+
+			/// @brief Document with all agents, rebuilt after a scan with changes.
+			std::shared_ptr<const std::string> document;
+
+			/// @brief Recent changes, oldest first.
+			std::deque<Change> history;
+			size_t history_size = 1024;
+
+			/// @brief Change listeners by id.
+			std::map<unsigned int,Listener> listeners;
+			unsigned int last_id = 0;
+
+			/// @brief Fingerprint of the worker names, only used by the watcher thread.
+			size_t workers = 0;
+
+			/// @brief Interval between scans.
+			std::chrono::milliseconds interval{1000};
+
+			std::thread *thread = nullptr;
+			bool running = false;
+			std::condition_variable cond;
+
+			/// @brief Signaled after a scan with changes.
+			std::condition_variable changed;
+
+			Watcher();
+
+			/// @brief Check the agent tree for changes.
+			void scan();
+
+			/// @brief Build the agent frame.
+			static std::shared_ptr<const std::string> serialize(const Agent &agent);
+
+		public:
+			static Watcher & getInstance();
+
+			~Watcher();
+
+			/// @brief Start the watcher thread (if not started).
+			void start();
+
+			/// @brief Stop the watcher thread.
+			void stop();
+
+			/// @brief Append JSON string to buffer.
+			static void escape(std::string &buffer, const char *str);
+
+			/// @brief Check if the path is on the prefix.
+			/// @param prefix The agent path prefix ("" or "/" for all agents).
+			static bool match(const char *prefix, const std::string &path) noexcept;
+
+			/// @brief Add change listener, starts the watcher.
+			/// @return The listener id.
+			unsigned int subscribe(const Listener &listener);
+
+			/// @brief Remove change listener.
+			void unsubscribe(unsigned int id);
+
+			/// @brief Get the agent path from the request uri.
+			/// @param uri The request local uri.
+			/// @return The agent path ("" for root) or nullptr if it's not an agent request (/api/<version>/agent[/path]).
+			static const char * path(const char *uri) noexcept;
+
+			/// @brief Get the agent path prefix, without the output extension.
+			/// @param path The agent path from the request uri.
+			static std::string prefix(const char *path);
+
+			/// @brief Get the last version.
+			uint64_t last();
+
+			/// @brief Get the version token sent to the clients ("<epoch>-<version>").
+			std::string token(uint64_t version) const;
+
+			/// @brief Get the version from a client token.
+			/// @param version Set to the version on the token.
+			/// @return false if the token is invalid or from another start of the service.
+			bool parse(const char *token, uint64_t &version) const noexcept;
+
+			/// @brief Get the changes after version.
+			/// @param since The last version seen by the client.
+			/// @param prefix The agent path prefix.
+			/// @return false if the changes after 'since' are not on the history anymore (or 'since' is ahead of it).
+			bool replay(uint64_t since, const char *prefix, const std::function<void(const Change &change)> &call);
+
+			/// @brief Wait for a change under prefix.
+			/// @param prefix The agent path prefix.
+			/// @param since Wait for versions after this one.
+			/// @param timeout Maximum wait.
+			/// @return The last version.
+			uint64_t wait(const char *prefix, uint64_t since, const std::chrono::milliseconds &timeout);
+
+			/// @brief Get the last change of each agent under prefix after version.
+			/// @param since The last version seen by the client.
+			/// @param prefix The agent path prefix.
+			/// @param full Set to true when 'since' is older than the history (or ahead of the current version) and all agents were sent.
+			/// @param call Called with the agent frame (removed agents included).
+			/// @return The last version.
+			uint64_t delta(uint64_t since, const char *prefix, bool &full, const std::function<void(const std::string &frame)> &call);
+
+			/// @brief Get the document with all agents.
+			/// @param version Set to the document version.
+			std::shared_ptr<const std::string> snapshot(uint64_t &version);
+
+			/// @brief Get the agents under the prefix.
+			void for_each(const char *prefix, const std::function<void(const Agent &agent)> &call);
+
+		};
+
+	}
+
+ }
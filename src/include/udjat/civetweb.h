@@ -20,12 +20,85 @@
  #pragma once
 
  #include <udjat/defs.h>
+ #include <chrono>
+ #include <functional>
+ #include <string>
+ #include <vector>
 
  namespace Udjat {
 
  	namespace CivetWeb {
 
+		/// @brief Result of a request from the client engine.
+		struct UDJAT_API Result {
+			std::string url;
+			int status = 0;					///< @brief HTTP status (0 if the request has failed).
+			std::string text;				///< @brief HTTP status text.
+			std::string body;				///< @brief Response body.
+			int error = 0;					///< @brief System error (ETIMEDOUT, ECONNREFUSED, ...).
+			std::string message;			///< @brief Error message.
+			std::chrono::milliseconds elapsed{0};
+		};
 
+		/// @brief Request phases (monotonic clock).
+		struct UDJAT_API Timing {
+			bool reused = false;						///< @brief Session from the pool (no dns, connect or tls).
+			std::chrono::microseconds dns{0};			///< @brief Name resolution.
+			std::chrono::microseconds connect{0};		///< @brief TCP connection.
+			std::chrono::microseconds tls{0};			///< @brief TLS handshake.
+			std::chrono::microseconds ttfb{0};			///< @brief Sending the request to the first response byte.
+			std::chrono::microseconds transfer{0};		///< @brief Response body.
+			std::chrono::microseconds total{0};
+		};
+
+		/// @brief Worker with the phases of its last request.
+		/// @details The civetweb protocol workers implement it, get it from the worker with
+		/// dynamic_cast<const CivetWeb::Timed *>(worker.get()) after test().
+		class UDJAT_API Timed {
+		public:
+			virtual ~Timed();
+
+			/// @brief Phases of the last request.
+			virtual const Timing & timings() const noexcept = 0;
+
+		};
+
+		/// @brief The client engine, provided by the civetweb module while it's loaded.
+		class UDJAT_API Fetcher {
+		private:
+			static Fetcher *instance;
+
+		protected:
+			Fetcher();
+
+		public:
+			virtual ~Fetcher();
+
+			/// @brief Get the active client engine.
+			/// @exception std::runtime_error if the civetweb module isn't loaded.
+			static Fetcher & getInstance();
+
+			/// @brief Get the urls concurrently.
+			virtual std::vector<Result> get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout) = 0;
+
+			/// @brief Start a GET request.
+			virtual void get(const char *url, const std::function<void(const Result &result)> &callback, const std::chrono::milliseconds &timeout) = 0;
+
+		};
+
+		/// @brief Get the urls concurrently, the requests run on the client engine thread.
+		/// @param urls The urls to get.
+		/// @param timeout Timeout for each request (0 for the http/timeout value).
+		/// @return Results in the order of the urls, after all are finished.
+		/// @exception std::runtime_error if the civetweb module isn't loaded.
+		UDJAT_API std::vector<Result> get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout = std::chrono::milliseconds{0});
+
+		/// @brief Start a GET request on the client engine.
+		/// @param url The url to get.
+		/// @param callback Called on the main loop when finished.
+		/// @param timeout Request timeout (0 for the http/timeout value).
+		/// @exception std::runtime_error if the civetweb module isn't loaded.
+		UDJAT_API void get(const char *url, const std::function<void(const Result &result)> &callback, const std::chrono::milliseconds &timeout = std::chrono::milliseconds{0});
 
  	}
 
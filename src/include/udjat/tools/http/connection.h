@@ -49,6 +49,9 @@
 			/// @retval 404 No index page.
 			int info(const char *path);
 
+			/// @brief Invalidate the cached index page (agents, workers or modules have changed).
+			static void invalidate() noexcept;
+
 			/// @brief Get text for response..
 			/// @param response Response to.
 			/// @param mimetype The mimetype for response.
@@ -63,6 +66,11 @@
 			/// @return http error response (200).
 			virtual int send(const char *mime_type, const char *response, size_t length) const noexcept = 0;
 
+			/// @brief Send string with entity tag.
+			/// @param etag The entity tag; if it matches the client's If-None-Match, send '304 Not Modified'.
+			/// @return http response code.
+			virtual int send(const char *mime_type, const char *response, size_t length, const char *etag) const noexcept;
+
 			/// @brief Send file.
 			/// @param Method The HTTP method from client.
 			/// @param filename The filename to send.
@@ -79,6 +87,11 @@
 			/// @return Error code.
 			virtual int send(int code, const char *title, const char *body = "") const noexcept;
 
+			/// @brief Send '202 Accepted' response.
+			/// @param location The URL for the pending response.
+			/// @return HTTP response code.
+			virtual int accepted(const char *location) const noexcept;
+
 			/// @brief Send 'operation failed' response.
 			/// @param code The HTTP status code (see HTTP standard).
 			/// @param message The message.
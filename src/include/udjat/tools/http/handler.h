@@ -24,7 +24,9 @@
  #include <udjat/tools/http/connection.h>
  #include <udjat/tools/http/mimetype.h>
  #include <udjat/tools/http/request.h>
+ #include <udjat/tools/http/response.h>
  #include <cstring>
+ #include <functional>
 
  namespace Udjat {
 
@@ -33,10 +35,14 @@
 		class UDJAT_API Handler {
 		protected:
 			const char * path;	///< @brief The path for this requests.
+			unsigned int limit;	///< @brief Concurrency limit for the path (0 = unlimited).
 
 			/// @brief Create a new httpd handler, insert it to default server.
 			/// @param path the path for the handler.
-			Handler(const char *path);
+			/// @param limit Requests running at the same time on the path (0 = unlimited).
+			Handler(const char *path, unsigned int limit = 0);
+
+			/// @brief Create handler from xml node, the concurrency limit is the 'max-in-flight' attribute.
 			Handler(const XML::Node &node, const char *tagname = "http-handler");
 
 		public:
@@ -54,11 +60,40 @@
 				return path;
 			}
 
+			/// @brief Get the concurrency limit (0 = unlimited).
+			inline unsigned int concurrency() const noexcept {
+				return limit;
+			}
+
 			/// @brief Handle request.
 			virtual int handle(const Udjat::HTTP::Connection &conn, const Udjat::HTTP::Request &request, const Udjat::MimeType mimetype) = 0;
 
 		};
 
+		/// @brief Handler running the request away from the connection thread.
+		/// @details If the job doesn't finish in 'async-wait' milliseconds the client
+		/// receives '202 Accepted' with the location of the pending response.
+		class UDJAT_API AsyncHandler : public Handler {
+		protected:
+			AsyncHandler(const char *path) : Handler{path} {
+			}
+
+			AsyncHandler(const XML::Node &node, const char *tagname = "http-handler") : Handler{node,tagname} {
+			}
+
+			/// @brief Prepare the job for request (runs on the connection thread).
+			/// @param request The client request, not available after return.
+			/// @param mimetype The mimetype for response.
+			/// @return The job to run on the background pool.
+			virtual std::function<void(Udjat::HTTP::Response &response)> prepare(const Udjat::HTTP::Request &request, const Udjat::MimeType mimetype) = 0;
+
+		public:
+
+			/// @brief Queue the request job, send response or the pending location.
+			int handle(const Udjat::HTTP::Connection &conn, const Udjat::HTTP::Request &request, const Udjat::MimeType mimetype) override;
+
+		};
+
 	}
 
  }
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the pending response, completed away from the connection thread.
+  */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/tools/http/mimetype.h>
+ #include <udjat/tools/http/response.h>
+ #include <functional>
+ #include <memory>
+ #include <mutex>
+ #include <condition_variable>
+ #include <string>
+ #include <ctime>
+
+ namespace Udjat {
+
+	namespace HTTP {
+
+		/// @brief Response being built by the background pool.
+		class UDJAT_API Pending {
+		private:
+			class Controller;
+			friend class Controller;
+
+			/// @brief The pending id, used to build the location.
+			std::string id;
+
+			/// @brief The location for the pending response.
+			std::string url;
+
+			/// @brief Mimetype for the response.
+			const MimeType mimetype;
+
+			/// @brief Expiration time for completed responses.
+			time_t expires = 0;
+
+			/// @brief The response, nullptr while running.
+			std::shared_ptr<HTTP::Response> result;
+
+			std::mutex guard;
+			std::condition_variable cond;
+
+		public:
+			Pending(const char *id, const MimeType mimetype);
+
+			/// @brief Queue job on the background pool.
+			/// @param mimetype The mimetype for response.
+			/// @param job The job to run; it will fill the response.
+			/// @return The pending response.
+			/// @exception HTTP::Exception 503 when 'http/async-max-pending' responses are pending.
+			static std::shared_ptr<Pending> push(const MimeType mimetype, const std::function<void(HTTP::Response &response)> &job);
+
+			/// @brief Get the path for the pending responses ('http/pending-path', with leading and trailing slashes).
+			static std::string path();
+
+			/// @brief Find pending response.
+			/// @param id The pending id.
+			/// @return The pending response or nullptr if not found (or expired).
+			static std::shared_ptr<Pending> find(const char *id);
+
+			inline const char * c_str() const noexcept {
+				return id.c_str();
+			}
+
+			/// @brief Get the URL for the client to fetch the response.
+			inline const char * location() const noexcept {
+				return url.c_str();
+			}
+
+			/// @brief Wait for the job.
+			/// @param msec Time to wait (in milliseconds).
+			/// @return true if the response is available.
+			bool wait(unsigned int msec);
+
+			/// @brief Get completed response, remove it from the pending list.
+			/// @return The response or nullptr if the job still running.
+			std::shared_ptr<HTTP::Response> response();
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares the request stage timing.
+  */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <chrono>
+ #include <functional>
+ #include <string>
+ #include <cstdint>
+
+ namespace Udjat {
+
+	namespace HTTP {
+
+		/// @brief Time spent on each stage of the request running on the current thread.
+		class UDJAT_API Timing {
+		public:
+
+			enum Stage : unsigned int {
+				Negotiation,	///< @brief Mime-type negotiation.
+				Parse,			///< @brief Request construction (form parsing).
+				Probe,			///< @brief Worker::probe.
+				Work,			///< @brief Worker::work.
+				Serialize,		///< @brief Response serialization.
+				Write,			///< @brief Socket write.
+
+				StageCount
+			};
+
+			/// @brief Span of a stage, adds the elapsed time to the current request.
+			class UDJAT_API Span {
+			private:
+				const Stage stage;
+				std::chrono::steady_clock::time_point started;
+				bool active;
+
+			public:
+				Span(const Stage stage) noexcept;
+				~Span();
+			};
+
+			/// @brief Get the stage name.
+			static const char * name(const Stage stage) noexcept;
+
+			/// @brief Start timing the request on the current thread.
+			static void begin() noexcept;
+
+			/// @brief Is the current thread timing a request?
+			static bool enabled() noexcept;
+
+			/// @brief Get time spent on stage by the current request (microseconds).
+			static uint64_t get(const Stage stage) noexcept;
+
+			/// @brief Set the worker selected for the current request.
+			/// @param name The worker name (should be static).
+			static void worker(const char *name) noexcept;
+
+			/// @brief Get the worker selected for the current request.
+			static const char * worker() noexcept;
+
+			/// @brief Get time since begin() (microseconds).
+			static uint64_t elapsed() noexcept;
+
+			/// @brief Get the stages of the current request as a Server-Timing header value.
+			static std::string to_string();
+
+			/// @brief Request has finished, add it to the stage aggregates.
+			static void end() noexcept;
+
+			/// @brief Stop timing the current request without adding it to the aggregates.
+			static void cancel() noexcept;
+
+			/// @brief Get the stage aggregates.
+			/// @param call Called for every stage with the request count, total and max time (microseconds).
+			static void for_each(const std::function<void(const Stage stage, uint64_t count, uint64_t total, uint64_t max)> &call);
+
+		};
+
+	}
+
+ }
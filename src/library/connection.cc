@@ -24,6 +24,7 @@
  #include <udjat/tools/http/exception.h>
  #include <udjat/tools/http/response.h>
  #include <udjat/tools/intl.h>
+ #include <cstring>
 
  using namespace std;
 
@@ -43,6 +44,14 @@
 		return send(code,_("Operation failed"), message);
 	}
 
+	int HTTP::Connection::send(const char *mime_type, const char *response, size_t length, const char *) const noexcept {
+		return send(mime_type,response,length);
+	}
+
+	int HTTP::Connection::accepted(const char *location) const noexcept {
+		return send("text/plain",location,strlen(location));
+	}
+
 	int HTTP::Connection::success(const char *mime_type, const char *response, size_t length) const noexcept {
 		return send(mime_type,response,length);
 	}
@@ -30,6 +30,7 @@
  #include <udjat/tools/http/report.h>
  #include <udjat/tools/http/mimetype.h>
  #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/http/timing.h>
  #include <udjat/tools/worker.h>
  #include <udjat/tools/logger.h>
  #include <udjat/tools/intl.h>
@@ -39,26 +40,46 @@
 
  namespace Udjat {
 
+	template <typename T>
+	static inline void trace_failure(const T &response) {
+		if(Logger::enabled(Logger::Trace)) {
+			Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+		}
+	}
+
+	template <typename T>
+	static inline bool work(const Worker *worker, Request &request, T &response) {
+		HTTP::Timing::Span span{HTTP::Timing::Work};
+		return worker->work(request,response);
+	}
+
 	int HTTP::Request::exec(HTTP::Connection &connection) {
 
 		Worker::ResponseType response_type = Worker::None;
 		const Worker *worker = nullptr;
 
-		Worker::for_each([&worker,&response_type,this](const Worker &w){
-			response_type = w.probe(*this);
-			if(response_type != Worker::None) {
-				worker = &w;
-				return true;
-			}
-			return false;
-		});
+		{
+			HTTP::Timing::Span span{HTTP::Timing::Probe};
+			Worker::for_each([&worker,&response_type,this](const Worker &w){
+				response_type = w.probe(*this);
+				if(response_type != Worker::None) {
+					worker = &w;
+					return true;
+				}
+				return false;
+			});
+		}
+
+		if(worker) {
+			HTTP::Timing::worker(worker->c_str());
+		}
 
 		switch(response_type) {
 		case Worker::None:
 			{
 				HTTP::Response response{(MimeType) connection};
 				response.failed(ENOENT);
-				Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+				trace_failure(response);
 				return connection.send(response);
 			}
 
@@ -69,9 +90,9 @@
 				}
 
 				HTTP::Response response{(MimeType) connection};
-				if(!worker->work(*this,response)) {
+				if(!work(worker,*this,response)) {
 					response.failed(ENOENT);
-					Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+					trace_failure(response);
 					return connection.send(response);
 				}
 				return connection.send(response);
@@ -80,9 +101,9 @@
 		case Worker::Table:
 			{
 				HTTP::Report response{(MimeType) connection};
-				if(!worker->work(*this,response)) {
+				if(!work(worker,*this,response)) {
 					response.failed(ENOENT);
-					Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+					trace_failure(response);
 					return connection.send(response);
 				}
 				return connection.send(response);
@@ -96,9 +117,9 @@
 
 					// List
 					HTTP::Report response{(MimeType) connection};
-					if(!worker->work(*this,response)) {
+					if(!work(worker,*this,response)) {
 						response.failed(ENOENT);
-						Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+						trace_failure(response);
 						return connection.send(response);
 					}
 					return connection.send(response);
@@ -112,9 +133,9 @@
 
 					// All others
 					HTTP::Response response{(MimeType) connection};
-					if(!worker->work(*this,response)) {
+					if(!work(worker,*this,response)) {
 						response.failed(ENOENT);
-						Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+						trace_failure(response);
 						return connection.send(response);
 					}
 					return connection.send(response);
@@ -128,7 +149,7 @@
 		{
 			HTTP::Response response{(MimeType) connection};
 			response.failed(ENOENT);
-			Logger::String("Request has failed with error ",response.status_code()).trace("civetweb");
+			trace_failure(response);
 			return connection.send(response);
 		}
 
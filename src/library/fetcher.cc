@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client entry points, the engine and the workers are on the module.
+  */
+
+ #include <config.h>
+ #include <stdexcept>
+ #include <udjat/civetweb.h>
+ #include <iostream>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	CivetWeb::Fetcher * CivetWeb::Fetcher::instance = nullptr;
+
+	CivetWeb::Fetcher & CivetWeb::Fetcher::getInstance() {
+		if(instance) {
+			return *instance;
+		}
+
+		throw runtime_error("The HTTP client engine is unavailable");
+	}
+
+	CivetWeb::Fetcher::Fetcher() {
+
+		// Check for secondary instance.
+		if(instance) {
+			clog << "httpd\tBuilding a new HTTP client engine instance" << endl;
+		} else {
+			instance = this;
+		}
+	}
+
+	CivetWeb::Fetcher::~Fetcher() {
+		if(instance == this) {
+			instance = nullptr;
+		}
+	}
+
+	CivetWeb::Timed::~Timed() {
+	}
+
+	std::vector<CivetWeb::Result> CivetWeb::get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout) {
+		return Fetcher::getInstance().get(urls,timeout);
+	}
+
+	void CivetWeb::get(const char *url, const std::function<void(const Result &result)> &callback, const std::chrono::milliseconds &timeout) {
+		Fetcher::getInstance().get(url,callback,timeout);
+	}
+
+ }
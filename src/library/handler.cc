@@ -28,7 +28,7 @@
 
  namespace Udjat {
 
-	HTTP::Handler::Handler(const char *p) : path{p} {
+	HTTP::Handler::Handler(const char *p, unsigned int l) : path{p}, limit{l} {
 
 		if(!(path && *path)) {
 			throw system_error(EINVAL,system_category(),"http-handler attribute is required");
@@ -46,7 +46,7 @@
 
 	}
 
-	HTTP::Handler::Handler(const pugi::xml_node &node, const char *tagname) : HTTP::Handler{Quark{node,tagname,""}.c_str()} {
+	HTTP::Handler::Handler(const pugi::xml_node &node, const char *tagname) : HTTP::Handler{Quark{node,tagname,""}.c_str(),node.attribute("max-in-flight").as_uint(0)} {
 	}
 
 	HTTP::Handler::~Handler() {
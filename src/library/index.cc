@@ -37,141 +37,203 @@
  #include <udjat/tools/string.h>
  #include <udjat/tools/http/icon.h>
  #include <sstream>
+ #include <atomic>
+ #include <mutex>
+ #include <memory>
+ #include <map>
+ #include <ctime>
+ #include <cstdio>
+ #include <functional>
 
  using namespace std;
  using namespace Udjat;
 
- int HTTP::Connection::info(const char *path) {
+ namespace {
 
-	debug("local_uri='",path,"'");
+	/// @brief The index page for the current locale.
+	struct Page {
+		unsigned int generation = 0;
+		time_t expires = 0;
+		string text;
+		string etag;
+	};
 
-	if(!strcasecmp(path,Config::Value<string>("http","appinfo","/"))) {
+	std::atomic<unsigned int> generation{0};
+	std::mutex guard;
 
-		debug("Sending application info");
+	/// @brief Rendered pages by locale.
+	std::map<string,std::shared_ptr<Page>> pages;
+
+ }
+
+ static std::shared_ptr<Page> render() {
+
+	auto result = make_shared<Page>();
+
+	// Set before rendering, a change while rendering invalidates this page.
+	result->generation = generation;
+	result->expires = time(0) + Config::Value<unsigned int>("http","index-cache-ttl",5);
+
+	stringstream page;
+
+	page << "<!DOCTYPE html>"
+			"<html lang=\"" << _("en") << "\">"
+			"<head>"
+			"<meta charset=\"utf-8\">";
+
+	page << "<title>" << Application::Name() << "</title>";
+
+	page <<	"</head><body>";
+
+	page << "<h1>" << Application::Name() << "</h1>";
 
-		stringstream page;
+	// Agent information
+	try {
 
-		page << "<!DOCTYPE html>"
-				"<html lang=\"" << _("en") << "\">"
-				"<head>"
-				"<meta charset=\"utf-8\">";
+		auto root = Udjat::Abstract::Agent::root();
+		if(root) {
 
-		page << "<title>" << Application::Name() << "</title>";
+			page	<< "<h2>" << _("Active agents") << "</h2><ul>"
+					<< "<li><a href=\"/api/1.0/htmlagent.html\">";
 
-		page <<	"</head><body>";
+			{
+				auto icon = HTTP::Icon::getInstance(std::to_string(Abstract::Agent::root()->state()->level()));
+				if(icon) {
+					page << "<img src=\"icon/" << icon << ".svg\" height=\"16\" style=\"vertical-align:bottom\"/>&nbsp;";
+				}
+			}
 
-		page << "<h1>" << Application::Name() << "</h1>";
+			page	<< _("Application") << "</a></li>";
 
-		// Agent information
-		try {
+			root->for_each([&page,root](Abstract::Agent &agent){
+
+				if(&agent == root.get()) {
+					return;
+				}
+
+				const char *summary = agent.summary();
+
+				if(!(summary && *summary)) {
+					summary = agent.label();
+				}
 
-			auto root = Udjat::Abstract::Agent::root();
-			if(root) {
+				if(!(summary && *summary)) {
+					summary = agent.name();
+				}
 
-				page	<< "<h2>" << _("Active agents") << "</h2><ul>"
-						<< "<li><a href=\"/api/1.0/htmlagent.html\">";
+				page << "<li><a href=\"/api/1.0/agent" << agent.path() << ".html\">";
 
 				{
-					auto icon = HTTP::Icon::getInstance(std::to_string(Abstract::Agent::root()->state()->level()));
+					auto icon = HTTP::Icon::getInstance(std::to_string(agent.state()->level()));
 					if(icon) {
 						page << "<img src=\"icon/" << icon << ".svg\" height=\"16\" style=\"vertical-align:bottom\"/>&nbsp;";
 					}
 				}
 
-				page	<< _("Application") << "</a></li>";
+				page << agent.name() << "&nbsp;<small>(" << summary << ")</small></a></li>";
 
-				root->for_each([&page,root](Abstract::Agent &agent){
+			});
 
-					if(&agent == root.get()) {
-						return;
-					}
+			page << "</ul>";
+		}
 
-					const char *summary = agent.summary();
+	} catch(const std::exception &e) {
 
-					if(!(summary && *summary)) {
-						summary = agent.label();
-					}
+		cerr << "civetweb\tCant get agent list: " << e.what() << endl;
 
-					if(!(summary && *summary)) {
-						summary = agent.name();
-					}
+	}
 
-					page << "<li><a href=\"/api/1.0/agent" << agent.path() << ".html\">";
+	// Workers
+	{
+		page << "<h2>" << _("Workers") << "</h2><ul>";
 
-					{
-						auto icon = HTTP::Icon::getInstance(std::to_string(agent.state()->level()));
-						if(icon) {
-							page << "<img src=\"icon/" << icon << ".svg\" height=\"16\" style=\"vertical-align:bottom\"/>&nbsp;";
-						}
-					}
+		Udjat::Worker::for_each([&page](const Worker &worker){
 
-					page << agent.name() << "&nbsp;<small>(" << summary << ")</small></a></li>";
+			page 	<< "<li><a href=\"" << "/api/1.0/"
+					<< worker.c_str()
+					<< ".html\">"
+					<< worker.c_str()
+					<< "</a>";
 
-				});
+			return false;
 
-				page << "</ul>";
-			}
+		});
 
-		} catch(const std::exception &e) {
+		page << "</ul>";
+	}
 
-			cerr << "civetweb\tCant get agent list: " << e.what() << endl;
+	// Application information
+	{
+		auto module = Udjat::Module::find("information");
+		if(module) {
 
-		}
+			auto options = (*module)["options"];
 
-		// Workers
-		{
-			page << "<h2>" << _("Workers") << "</h2><ul>";
+			if(!options.empty()) {
 
-			Udjat::Worker::for_each([&page](const Worker &worker){
+				page << "<h2>" << ( (*module)["description"]) << "</h2><ul>";
 
-				page 	<< "<li><a href=\"" << "/api/1.0/"
-						<< worker.c_str()
-						<< ".html\">"
-						<< worker.c_str()
-						<< "</a>";
+				for(auto option : String{options}.split(",")) {
 
-				return false;
+					page 	<< "<li><a href=\"" << "/api/1.0/info/"
+							<< option
+							<< ".html\">"
+							<< option
+							<< "</a></li>";
 
-			});
+				}
+
+				page << "</ul>";
+
+			}
 
-			page << "</ul>";
 		}
 
-		// Application information
-		{
-			auto module = Udjat::Module::find("information");
-			if(module) {
+	}
 
-				auto options = (*module)["options"];
+	page << "</body></html>";
 
-				if(!options.empty()) {
+	result->text = page.str();
 
-					page << "<h2>" << ( (*module)["description"]) << "</h2><ul>";
+	char etag[24];
+	snprintf(etag,sizeof(etag),"\"%zx\"",std::hash<string>{}(result->text));
+	result->etag = etag;
 
-					for(auto option : String{options}.split(",")) {
+	return result;
 
-						page 	<< "<li><a href=\"" << "/api/1.0/info/"
-								<< option
-								<< ".html\">"
-								<< option
-								<< "</a></li>";
+ }
 
-					}
+ void HTTP::Connection::invalidate() noexcept {
+	generation++;
+ }
 
-					page << "</ul>";
+ int HTTP::Connection::info(const char *path) {
 
-				}
+	debug("local_uri='",path,"'");
 
-			}
+	if(!strcasecmp(path,Config::Value<string>("http","appinfo","/"))) {
 
-		}
+		debug("Sending application info");
 
-		page << "</body></html>";
+		std::shared_ptr<Page> index;
+
+		static const bool cached = Config::Value<bool>("http","index-cache",false);
+		if(cached) {
+			lock_guard<mutex> lock(guard);
+			auto &entry = pages[_("en")];
+			if(!entry || entry->generation != generation || entry->expires < time(0)) {
+				entry = render();
+			}
+			index = entry;
+		} else {
+			index = render();
+		}
 
 		return send(
 				to_string(MimeType::html),
-				page.str().c_str(),
-				page.str().size()
+				index->text.c_str(),
+				index->text.size(),
+				index->etag.c_str()
 			);
 
 	} else if(!strcasecmp(path,"/favicon.ico")) {
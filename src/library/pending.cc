@@ -0,0 +1,265 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the pending response controller and the async handler.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/http/pending.h>
+ #include <udjat/tools/http/handler.h>
+ #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/intl.h>
+ #include <map>
+ #include <list>
+ #include <thread>
+ #include <chrono>
+ #include <random>
+ #include <cstdio>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	namespace HTTP {
+
+		class UDJAT_PRIVATE Pending::Controller {
+		private:
+			mutex guard;
+			condition_variable cond;
+			bool enabled = true;
+
+			/// @brief Pending responses by id.
+			map<string,shared_ptr<Pending>> entries;
+
+			/// @brief Jobs waiting for a thread.
+			list<pair<shared_ptr<Pending>,std::function<void(HTTP::Response &response)>>> queue;
+
+			list<thread> threads;
+
+			mt19937_64 generator{random_device{}()};
+
+			void run() {
+
+				unique_lock<mutex> lock(guard);
+
+				while(enabled) {
+
+					if(queue.empty()) {
+						cond.wait(lock);
+						continue;
+					}
+
+					auto job = queue.front();
+					queue.pop_front();
+
+					lock.unlock();
+
+					auto response = make_shared<HTTP::Response>(job.first->mimetype);
+
+					try {
+
+						job.second(*response);
+
+					} catch(const std::exception &e) {
+
+						Logger::String{"Async job ",job.first->c_str()," has failed: ",e.what()}.error("http");
+						response->failed(e);
+
+					} catch(...) {
+
+						Logger::String{"Async job ",job.first->c_str()," has failed"}.error("http");
+						response->failed(_("Unexpected error on http handler"));
+
+					}
+
+					{
+						lock_guard<mutex> plock(job.first->guard);
+						job.first->result = response;
+						job.first->expires = time(0) + Config::Value<time_t>("http","async-result-ttl",60);
+					}
+					job.first->cond.notify_all();
+
+					lock.lock();
+
+				}
+
+			}
+
+			/// @brief Remove expired responses, must be called with the guard locked.
+			void cleanup() {
+
+				time_t now = time(0);
+
+				for(auto it = entries.begin(); it != entries.end();) {
+					lock_guard<mutex> plock(it->second->guard);
+					if(it->second->result && it->second->expires < now) {
+						it = entries.erase(it);
+					} else {
+						it++;
+					}
+				}
+
+			}
+
+		public:
+			Controller() {
+			}
+
+			~Controller() {
+
+				{
+					lock_guard<mutex> lock(guard);
+					enabled = false;
+				}
+				cond.notify_all();
+
+				for(thread &thread : threads) {
+					thread.join();
+				}
+
+			}
+
+			static Controller & getInstance() {
+				static Controller instance;
+				return instance;
+			}
+
+			shared_ptr<Pending> push(const MimeType mimetype, const std::function<void(HTTP::Response &response)> &job) {
+
+				lock_guard<mutex> lock(guard);
+
+				cleanup();
+
+				// Queued, running and not yet delivered responses.
+				if(entries.size() >= Config::Value<size_t>("http","async-max-pending",256)) {
+					throw HTTP::Exception(503, Pending::path().c_str(), "Too many pending responses");
+				}
+
+				if(threads.empty()) {
+					unsigned int count = Config::Value<unsigned int>("http","async-threads",4);
+					for(unsigned int ix = 0; ix < count; ix++) {
+						threads.emplace_back([this](){
+							run();
+						});
+					}
+				}
+
+				char id[33];
+				snprintf(id,sizeof(id),"%016llx%016llx",(unsigned long long) generator(),(unsigned long long) generator());
+
+				auto pending = make_shared<Pending>(id,mimetype);
+				entries[pending->id] = pending;
+				queue.emplace_back(pending,job);
+
+				cond.notify_one();
+
+				return pending;
+			}
+
+			shared_ptr<Pending> find(const char *id) {
+
+				lock_guard<mutex> lock(guard);
+
+				cleanup();
+
+				auto it = entries.find(id);
+				if(it == entries.end()) {
+					return shared_ptr<Pending>();
+				}
+				return it->second;
+
+			}
+
+			void remove(const Pending *pending) {
+				lock_guard<mutex> lock(guard);
+				entries.erase(pending->id);
+			}
+
+		};
+
+		Pending::Pending(const char *i, const MimeType m) : id{i}, mimetype{m} {
+			url = path();
+			url += id;
+		}
+
+		std::string Pending::path() {
+
+			string value{Config::Value<string>("http","pending-path","/pending/")};
+
+			if(value.empty() || value[0] != '/') {
+				value.insert(0,"/");
+			}
+
+			if(value.back() != '/') {
+				value += '/';
+			}
+
+			return value;
+
+		}
+
+		std::shared_ptr<Pending> Pending::push(const MimeType mimetype, const std::function<void(HTTP::Response &response)> &job) {
+			return Controller::getInstance().push(mimetype,job);
+		}
+
+		std::shared_ptr<Pending> Pending::find(const char *id) {
+			return Controller::getInstance().find(id);
+		}
+
+		bool Pending::wait(unsigned int msec) {
+			unique_lock<mutex> lock(guard);
+			return cond.wait_for(lock,chrono::milliseconds(msec),[this]{ return (bool) result; });
+		}
+
+		std::shared_ptr<HTTP::Response> Pending::response() {
+
+			shared_ptr<HTTP::Response> response;
+
+			{
+				lock_guard<mutex> lock(guard);
+				response = result;
+			}
+
+			if(response) {
+				Controller::getInstance().remove(this);
+			}
+
+			return response;
+		}
+
+		int AsyncHandler::handle(const HTTP::Connection &conn, const HTTP::Request &request, const MimeType mimetype) {
+
+			auto pending = Pending::push(mimetype,prepare(request,mimetype));
+
+			if(pending->wait(Config::Value<unsigned int>("http","async-wait",100))) {
+				return conn.send(*pending->response());
+			}
+
+			debug("Request '",request.c_str(),"' still running, sending ",pending->location());
+			return conn.accepted(pending->location());
+
+		}
+
+	}
+
+ }
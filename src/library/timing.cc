@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the request stage timing.
+  *
+  * Spans outside a timed request don't read the clock.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/http/timing.h>
+ #include <atomic>
+ #include <cstdio>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	/// @brief The request running on this thread.
+	static thread_local struct {
+		bool active = false;
+		steady_clock::time_point started;
+		uint64_t stages[HTTP::Timing::StageCount];
+		const char *worker = "";
+	} current;
+
+	/// @brief Stage aggregates.
+	static struct {
+		std::atomic<uint64_t> count{0};
+		std::atomic<uint64_t> total{0};
+		std::atomic<uint64_t> max{0};
+	} aggregates[HTTP::Timing::StageCount];
+
+	const char * HTTP::Timing::name(const Stage stage) noexcept {
+
+		static const char *names[StageCount] = {
+			"mime",
+			"request",
+			"probe",
+			"work",
+			"serialize",
+			"write"
+		};
+
+		if(stage < StageCount) {
+			return names[stage];
+		}
+
+		return "unknown";
+
+	}
+
+	HTTP::Timing::Span::Span(const Stage s) noexcept : stage{s}, active{current.active} {
+		if(active) {
+			started = steady_clock::now();
+		}
+	}
+
+	HTTP::Timing::Span::~Span() {
+		if(active && current.active) {
+			current.stages[stage] += duration_cast<microseconds>(steady_clock::now() - started).count();
+		}
+	}
+
+	void HTTP::Timing::begin() noexcept {
+		current.active = true;
+		current.started = steady_clock::now();
+		current.worker = "";
+		for(auto &stage : current.stages) {
+			stage = 0;
+		}
+	}
+
+	void HTTP::Timing::worker(const char *name) noexcept {
+		current.worker = (name ? name : "");
+	}
+
+	const char * HTTP::Timing::worker() noexcept {
+		return current.worker;
+	}
+
+	bool HTTP::Timing::enabled() noexcept {
+		return current.active;
+	}
+
+	uint64_t HTTP::Timing::get(const Stage stage) noexcept {
+		return (current.active && stage < StageCount) ? current.stages[stage] : 0;
+	}
+
+	uint64_t HTTP::Timing::elapsed() noexcept {
+		if(!current.active) {
+			return 0;
+		}
+		return duration_cast<microseconds>(steady_clock::now() - current.started).count();
+	}
+
+	std::string HTTP::Timing::to_string() {
+
+		std::string value;
+
+		if(!current.active) {
+			return value;
+		}
+
+		char buffer[64];
+		for(unsigned int stage = 0; stage < StageCount; stage++) {
+			if(current.stages[stage]) {
+				snprintf(buffer,sizeof(buffer),"%s;dur=%.3f, ",name((Stage) stage),((double) current.stages[stage]) / 1000.0);
+				value += buffer;
+			}
+		}
+
+		snprintf(buffer,sizeof(buffer),"total;dur=%.3f",((double) elapsed()) / 1000.0);
+		value += buffer;
+
+		return value;
+
+	}
+
+	void HTTP::Timing::end() noexcept {
+
+		if(!current.active) {
+			return;
+		}
+
+		current.active = false;
+
+		for(unsigned int stage = 0; stage < StageCount; stage++) {
+
+			uint64_t value = current.stages[stage];
+			if(!value) {
+				continue;
+			}
+
+			aggregates[stage].count++;
+			aggregates[stage].total += value;
+
+			uint64_t max = aggregates[stage].max.load();
+			while(value > max && !aggregates[stage].max.compare_exchange_weak(max,value));
+
+		}
+
+	}
+
+	void HTTP::Timing::cancel() noexcept {
+		current.active = false;
+	}
+
+	void HTTP::Timing::for_each(const std::function<void(const Stage stage, uint64_t count, uint64_t total, uint64_t max)> &call) {
+		for(unsigned int stage = 0; stage < StageCount; stage++) {
+			call((Stage) stage, aggregates[stage].count.load(), aggregates[stage].total.load(), aggregates[stage].max.load());
+		}
+	}
+
+ }
@@ -0,0 +1,371 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the asynchronous access log.
+  *
+  * Request threads copy the entries to their own ring without locks or
+  * formatting; the writer thread formats every pending entry and writes
+  * them with a single call. Other threads (and messages from a full ring)
+  * go through a shared list under the lock, messages are never dropped.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/accesslog.h>
+ #include <private/request.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <iostream>
+ #include <cstring>
+ #include <chrono>
+ #include <algorithm>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	/// @brief The request running on this thread.
+	static thread_local steady_clock::time_point started;
+
+	/// @brief Is this a request thread? Only those get a ring.
+	static thread_local bool request_thread = false;
+
+	/// @brief Format the entry time.
+	static size_t timestamp(char *buffer, size_t length, time_t when) noexcept {
+		struct tm tm;
+#ifdef _WIN32
+		localtime_s(&tm,&when);
+#else
+		localtime_r(&when,&tm);
+#endif // _WIN32
+		return strftime(buffer,length,"%Y-%m-%d %H:%M:%S ",&tm);
+	}
+
+	static inline void copy(char *to, const char *from, size_t length) noexcept {
+		if(!from) {
+			*to = 0;
+			return;
+		}
+		strncpy(to,from,length-1);
+		to[length-1] = 0;
+	}
+
+	CivetWeb::AccessLog::AccessLog() {
+	}
+
+	CivetWeb::AccessLog::~AccessLog() {
+		stop();
+	}
+
+	CivetWeb::AccessLog & CivetWeb::AccessLog::getInstance() {
+		static AccessLog instance;
+		return instance;
+	}
+
+	void CivetWeb::AccessLog::setup() {
+
+		lock_guard<mutex> lock(guard);
+
+		if(enabled) {
+			return;
+		}
+
+		// Round the ring size up to a power of 2.
+		size_t entries = Config::Value<unsigned int>("access-log","ring-size",1024);
+		size = 16;
+		while(size < entries) {
+			size <<= 1;
+		}
+
+		requests = Config::Value<bool>("access-log","requests",false);
+		sample = std::max((unsigned int) Config::Value<unsigned int>("access-log","sample",1),1U);
+		interval = std::max((unsigned int) Config::Value<unsigned int>("access-log","interval",250),10U);
+
+		string filename = Config::Value<string>("access-log","file","");
+		if(!filename.empty()) {
+			file = fopen(filename.c_str(),"a");
+			if(!file) {
+				Logger::String{"Cant open '",filename.c_str(),"': ",strerror(errno)}.error("civetweb");
+			}
+		}
+
+		enabled = true;
+
+		writer = new std::thread([this](){
+
+			unique_lock<mutex> lock(guard);
+			while(enabled) {
+				cond.wait_for(lock,milliseconds(interval));
+				lock.unlock();
+				drain();
+				lock.lock();
+			}
+
+		});
+
+	}
+
+	void CivetWeb::AccessLog::stop() {
+
+		{
+			lock_guard<mutex> lock(guard);
+			if(!enabled) {
+				return;
+			}
+			enabled = false;
+			cond.notify_all();
+		}
+
+		if(writer) {
+			writer->join();
+			delete writer;
+			writer = nullptr;
+		}
+
+		drain();
+
+		if(file) {
+			fclose(file);
+			file = nullptr;
+		}
+
+	}
+
+	CivetWeb::AccessLog::Ring & CivetWeb::AccessLog::ring() {
+
+		struct Registration {
+			std::shared_ptr<Ring> ring;
+
+			Registration() {
+				AccessLog &log = AccessLog::getInstance();
+				lock_guard<mutex> lock(log.guard);
+				ring = make_shared<Ring>(log.size);
+				log.rings.push_back(ring);
+			}
+
+			~Registration() {
+				// The writer removes the ring after draining it.
+				ring->closed = true;
+			}
+
+		};
+
+		static thread_local Registration registration;
+		return *registration.ring;
+
+	}
+
+	CivetWeb::AccessLog::Entry * CivetWeb::AccessLog::reserve() noexcept {
+
+		try {
+
+			Ring &ring = this->ring();
+
+			size_t head = ring.head.load(memory_order_relaxed);
+			if(head - ring.tail.load(memory_order_acquire) > ring.mask) {
+				return nullptr;
+			}
+
+			return &ring.entries[head & ring.mask];
+
+		} catch(...) {
+		}
+
+		return nullptr;
+
+	}
+
+	void CivetWeb::AccessLog::commit() noexcept {
+		Ring &ring = this->ring();
+		ring.head.store(ring.head.load(memory_order_relaxed)+1,memory_order_release);
+		counters.queued++;
+	}
+
+	void CivetWeb::AccessLog::begin() noexcept {
+		started = steady_clock::now();
+		request_thread = true;
+	}
+
+	void CivetWeb::AccessLog::push(const char *message) noexcept {
+
+		if(!enabled) {
+			// No writer, log it now.
+			clog << "civetweb\t" << message << endl;
+			return;
+		}
+
+		if(request_thread) {
+
+			Entry *entry = reserve();
+			if(entry) {
+				entry->type = Entry::Message;
+				entry->when = time(0);
+				copy(entry->text,message,sizeof(entry->text));
+				commit();
+				return;
+			}
+
+		}
+
+		try {
+
+			lock_guard<mutex> lock(guard);
+			if(messages.size() < size) {
+				messages.emplace_back(time(0),message);
+				counters.queued++;
+				return;
+			}
+
+		} catch(...) {
+		}
+
+		// The writer is behind, log it now.
+		clog << "civetweb\t" << message << endl;
+
+	}
+
+	void CivetWeb::AccessLog::push(const struct mg_connection *conn, int status, uint64_t bytes) noexcept {
+
+		if(!(enabled && requests)) {
+			return;
+		}
+
+		static thread_local unsigned int count = 0;
+		if(sample > 1 && (++count % sample) != 0) {
+			return;
+		}
+
+		Entry *entry = reserve();
+		if(!entry) {
+			counters.dropped++;
+			return;
+		}
+
+		const struct mg_request_info *info = mg_get_request_info(conn);
+
+		entry->type = Entry::Access;
+		entry->when = time(0);
+		entry->status = status;
+		entry->bytes = bytes;
+		entry->usec = duration_cast<microseconds>(steady_clock::now() - started).count();
+		copy(entry->client,Request::address(info).c_str(),sizeof(entry->client));
+		copy(entry->method,info->request_method,sizeof(entry->method));
+		copy(entry->text,info->request_uri,sizeof(entry->text));
+
+		commit();
+
+	}
+
+	void CivetWeb::AccessLog::drain() {
+
+		std::list<std::shared_ptr<Ring>> active;
+		std::list<std::pair<time_t,std::string>> shared;
+		{
+			lock_guard<mutex> lock(guard);
+			active = rings;
+			shared.swap(messages);
+		}
+
+		string batch;
+		size_t written = 0;
+		char buffer[512];
+
+		for(const auto &message : shared) {
+			timestamp(buffer,sizeof(buffer),message.first);
+			batch += buffer;
+			batch += "civetweb\t";
+			batch += message.second;
+			batch += '\n';
+			written++;
+		}
+
+		for(auto ring : active) {
+
+			size_t tail = ring->tail.load(memory_order_relaxed);
+			size_t head = ring->head.load(memory_order_acquire);
+
+			while(tail != head) {
+
+				const Entry &entry = ring->entries[tail & ring->mask];
+
+				size_t length = timestamp(buffer,sizeof(buffer),entry.when);
+
+				if(entry.type == Entry::Message) {
+					snprintf(buffer+length,sizeof(buffer)-length,"civetweb\t%s\n",entry.text);
+				} else {
+					snprintf(
+						buffer+length,sizeof(buffer)-length,
+						"%s \"%s %s\" %d %llu %.3fms\n",
+						entry.client,entry.method,entry.text,entry.status,
+						(unsigned long long) entry.bytes,((double) entry.usec) / 1000.0
+					);
+				}
+
+				batch += buffer;
+				written++;
+				tail++;
+
+			}
+
+			ring->tail.store(tail,memory_order_release);
+
+		}
+
+		if(!batch.empty()) {
+
+			if(file) {
+				fwrite(batch.c_str(),batch.size(),1,file);
+				fflush(file);
+			} else {
+				clog << batch << flush;
+			}
+
+			counters.written += written;
+			counters.batches++;
+
+		}
+
+		// Remove drained rings from the finished threads.
+		lock_guard<mutex> lock(guard);
+		rings.remove_if([](const std::shared_ptr<Ring> &ring){
+			return ring->closed && ring->tail.load() == ring->head.load();
+		});
+
+	}
+
+	void CivetWeb::AccessLog::get(Udjat::Value &value) {
+
+		{
+			lock_guard<mutex> lock(guard);
+			value["rings"] = (unsigned int) rings.size();
+		}
+
+		value["requests"] = requests;
+		value["sample"] = sample;
+		value["queued"] = (double) counters.queued;
+		value["written"] = (double) counters.written;
+		value["dropped"] = (double) counters.dropped;
+		value["batches"] = (double) counters.batches;
+
+	}
+
+ }
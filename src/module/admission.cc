@@ -0,0 +1,222 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the admission controller.
+  *
+  * Runs from the civetweb begin_request callback, before the request
+  * handlers; rejected requests get an immediate 503 with Retry-After.
+  *
+  * Route limits come from [http-admission-routes] and from the
+  * 'max-in-flight' attribute of the http handlers.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/admission.h>
+ #include <private/pool.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <memory>
+ #include <algorithm>
+ #include <vector>
+ #include <cstring>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Resources reserved by the current thread.
+	static thread_local struct {
+		bool global = false;
+		bool pool = false;
+		CivetWeb::Admission::Route *route = nullptr;
+	} reserved;
+
+	/// @brief Route table, replaced when a route is added.
+	static shared_ptr<const vector<CivetWeb::Admission::Route *>> table = make_shared<vector<CivetWeb::Admission::Route *>>();
+
+	CivetWeb::Admission::Admission() {
+	}
+
+	CivetWeb::Admission & CivetWeb::Admission::getInstance() {
+		static Admission instance;
+		return instance;
+	}
+
+	void CivetWeb::Admission::setup() {
+
+		max = Config::Value<unsigned int>("http-admission","max-in-flight",0);
+		budget = Config::Value<unsigned int>("http-admission","queue-budget",0);
+		retry = Config::Value<unsigned int>("http-admission","retry-after",1);
+
+		Config::for_each("http-admission-routes",[this](const char *path, const char *value){
+			set(path,(unsigned int) std::stoul(value));
+			return true;
+		});
+
+		if(budget && !CivetWeb::Pool::getInstance().enabled()) {
+			// Requests only wait for a slot with the concurrency limit.
+			Logger::String{"The queue budget requires 'concurrency-limit', ignoring it"}.warning("civetweb");
+			budget = 0;
+		}
+
+		if(max || budget) {
+			Logger::String{"Admission control enabled, max in flight: ",max,", queue budget: ",budget,"ms"}.info("civetweb");
+		}
+
+	}
+
+	void CivetWeb::Admission::set(const char *p, unsigned int limit) {
+
+		// The prefix matches whole path segments, without the trailing slash.
+		string path{p};
+		while(path.size() > 1 && path[path.size()-1] == '/') {
+			path.resize(path.size()-1);
+		}
+
+		lock_guard<mutex> lock(guard);
+
+		for(Route &route : routes) {
+			if(route.path == path) {
+				route.limit = limit;
+				Logger::String{"Concurrency limit for '",path,"' is ",limit}.trace("civetweb");
+				return;
+			}
+		}
+
+		// Routes are never removed, the table may be in use by the request threads.
+		routes.emplace_back(path.c_str(),limit);
+
+		auto updated = make_shared<vector<Route *>>();
+		for(Route &route : routes) {
+			updated->push_back(&route);
+		}
+
+		// Longest path first.
+		std::sort(updated->begin(),updated->end(),[](const Route *a, const Route *b){
+			return a->path.size() > b->path.size();
+		});
+
+		atomic_store(&table,shared_ptr<const vector<Route *>>(updated));
+
+		Logger::String{"Concurrency limit for '",path,"' is ",limit}.trace("civetweb");
+
+	}
+
+	int CivetWeb::Admission::reject(struct mg_connection *conn) noexcept {
+
+		mg_response_header_start(conn, 503);
+		mg_response_header_add(conn, "Retry-After", std::to_string(retry).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_add(conn, "Content-Length", "0", -1);
+		mg_response_header_send(conn);
+
+		return 503;
+
+	}
+
+	int CivetWeb::Admission::enter(struct mg_connection *conn) noexcept {
+
+		reserved.global = reserved.pool = false;
+		reserved.route = nullptr;
+
+		// Global cap.
+		if(active.fetch_add(1) >= max && max) {
+			active--;
+			counters.global++;
+			return reject(conn);
+		}
+		reserved.global = true;
+
+		// Route limit.
+		{
+			const char *uri = mg_get_request_info(conn)->local_uri;
+			auto routes = atomic_load(&table);
+			for(Route *route : *routes) {
+				size_t length = route->path.size();
+				if(!strncmp(uri,route->path.c_str(),length) && (!uri[length] || uri[length] == '/' || route->path[length-1] == '/')) {
+					if(route->limit && route->active.fetch_add(1) >= route->limit) {
+						route->active--;
+						route->rejected++;
+						counters.route++;
+						leave();
+						return reject(conn);
+					}
+					reserved.route = route;
+					break;
+				}
+			}
+		}
+
+		// Request thread slot.
+		if(!CivetWeb::Pool::getInstance().begin(budget)) {
+			counters.queue++;
+			leave();
+			return reject(conn);
+		}
+		reserved.pool = true;
+
+		counters.admitted++;
+		return 0;
+
+	}
+
+	void CivetWeb::Admission::leave() noexcept {
+
+		if(reserved.pool) {
+			CivetWeb::Pool::getInstance().end();
+			reserved.pool = false;
+		}
+
+		if(reserved.route) {
+			reserved.route->active--;
+			reserved.route = nullptr;
+		}
+
+		if(reserved.global) {
+			active--;
+			reserved.global = false;
+		}
+
+	}
+
+	void CivetWeb::Admission::get(Udjat::Value &value) {
+
+		value["max-in-flight"] = max;
+		value["queue-budget"] = budget;
+		value["in-flight"] = active.load();
+		value["admitted"] = (unsigned int) counters.admitted;
+		value["rejected-global"] = (unsigned int) counters.global;
+		value["rejected-route"] = (unsigned int) counters.route;
+		value["rejected-queue"] = (unsigned int) counters.queue;
+
+		Udjat::Value &list = value["routes"];
+		for(const Route *route : *atomic_load(&table)) {
+			Udjat::Value &item = list.append(Udjat::Value::Object);
+			item["path"] = route->path.c_str();
+			item["limit"] = route->limit.load();
+			item["active"] = route->active.load();
+			item["rejected"] = (unsigned int) route->rejected;
+		}
+
+	}
+
+ }
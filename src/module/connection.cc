@@ -18,6 +18,7 @@
  */
 
  #include <private/module.h>
+ #include <private/metrics.h>
  #include <sys/types.h>
  #include <sys/stat.h>
  #include <private/module.h>
@@ -25,11 +26,13 @@
  #include <udjat/tools/http/response.h>
  #include <udjat/tools/http/timestamp.h>
  #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/http/timing.h>
  #include <udjat/tools/logger.h>
  #include <udjat/tools/intl.h>
  #include <udjat/tools/string.h>
  #include <udjat/tools/configuration.h>
  #include <udjat/tools/application.h>
+ #include <cctype>
 
  #ifdef HAVE_UNISTD_H
 	#include <unistd.h>
@@ -42,6 +45,8 @@
 
 	CivetWeb::Connection::operator MimeType() const {
 
+		HTTP::Timing::Span span{HTTP::Timing::Negotiation};
+
 		const struct mg_request_info *info{mg_get_request_info(conn)};
 
 		if(strncasecmp(info->local_uri,"/api/",5) && Config::Value<bool>("httpd","allow-legacy-path",true)) {
@@ -65,23 +70,120 @@
 
 	int CivetWeb::Connection::send(const char *mime_type, const char *text, size_t length) const noexcept {
 
+		HTTP::Timing::Span span{HTTP::Timing::Write};
+
 		mg_response_header_start(conn, 200);
 		mg_response_header_add(conn, "Content-Type",mime_type,-1);
 		mg_response_header_add(conn, "Content-Length", std::to_string(length).c_str(), -1);
 		mg_response_header_send(conn);
 
 		// Send response.
+		CivetWeb::Metrics::sent(length);
+		mg_write(conn, text, length);
+
+		return 200;
+	}
+
+	int CivetWeb::Connection::send(const char *mime_type, const char *text, size_t length, const char *etag) const noexcept {
+
+		HTTP::Timing::Span span{HTTP::Timing::Write};
+
+		if(etag && etag_match(mg_get_header(conn, "If-None-Match"),etag)) {
+			// Counted by the metrics as a 3xx response without body.
+			mg_response_header_start(conn, 304);
+			mg_response_header_add(conn, "ETag", etag, -1);
+			mg_response_header_send(conn);
+			return 304;
+		}
+
+		mg_response_header_start(conn, 200);
+		mg_response_header_add(conn, "Content-Type",mime_type,-1);
+		mg_response_header_add(conn, "Content-Length", std::to_string(length).c_str(), -1);
+		if(etag) {
+			mg_response_header_add(conn, "ETag", etag, -1);
+			mg_response_header_add(conn, "Cache-Control", "no-cache", -1);
+		}
+		mg_response_header_send(conn);
+
+		CivetWeb::Metrics::sent(length);
 		mg_write(conn, text, length);
 
 		return 200;
 	}
 
+	int CivetWeb::Connection::accepted(const char *location) const noexcept {
+
+		mg_response_header_start(conn, 202);
+		mg_response_header_add(conn, "Location", location, -1);
+		mg_response_header_add(conn, "Retry-After", std::to_string(Config::Value<unsigned int>("http","async-retry-after",1)).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_add(conn, "Content-Length", "0", -1);
+		mg_response_header_send(conn);
+
+		return 202;
+	}
+
 	int CivetWeb::Connection::send(const Abstract::Response &response) const noexcept {
 		return ::send(conn,response);
 	}
 
  }
 
+ /// @brief Get the opaque tag, without the weak indicator and the spaces around.
+ static std::string opaque(const char *begin, const char *end) {
+	while(begin < end && isspace(*begin)) {
+		begin++;
+	}
+	while(end > begin && isspace(*(end-1))) {
+		end--;
+	}
+	if(end - begin >= 2 && begin[0] == 'W' && begin[1] == '/') {
+		begin += 2;
+	}
+	return std::string{begin,(size_t) (end-begin)};
+ }
+
+ bool etag_match(const char *header, const char *etag) noexcept {
+
+	if(!(header && *header && etag && *etag)) {
+		return false;
+	}
+
+	try {
+
+		std::string current{opaque(etag,etag+strlen(etag))};
+
+		const char *ptr = header;
+		while(*ptr) {
+
+			// The tags are quoted, commas inside the quotes aren't separators.
+			const char *begin = ptr;
+			bool quoted = false;
+			while(*ptr && (quoted || *ptr != ',')) {
+				if(*ptr == '"') {
+					quoted = !quoted;
+				}
+				ptr++;
+			}
+
+			std::string tag{opaque(begin,ptr)};
+			if(tag == "*" || tag == current) {
+				return true;
+			}
+
+			if(*ptr) {
+				ptr++;
+			}
+
+		}
+
+	} catch(...) {
+	}
+
+	return false;
+
+ }
+
  Udjat::MimeType MimeTypeFactory(struct mg_connection *conn, const Udjat::MimeType def) noexcept {
 
 	static const char *headers[] = { "Content-Type", "Accept" };
@@ -24,12 +24,17 @@
  #include <udjat/tools/http/request.h>
  #include <udjat/tools/intl.h>
  #include <private/module.h>
+ #include <private/metrics.h>
+ #include <udjat/tools/http/timing.h>
  #include <udjat/tools/logger.h>
 
  using namespace Udjat;
 
  int customWebHandler(struct mg_connection *conn, void *cbdata) noexcept {
 
+	CivetWeb::Metrics::begin(CivetWeb::Metrics::Custom);
+	HTTP::Timing::begin();
+
 	HTTP::Handler &handler = *((HTTP::Handler *) cbdata);
 
 	CivetWeb::Connection connection{conn};
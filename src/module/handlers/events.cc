@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the agent updates event stream (text/event-stream).
+  *
+  * Civetweb can't detach a connection from its request thread, so the
+  * streams are limited in number and in lifetime; the client reconnects
+  * with Last-Event-ID and gets the changes from the watcher history. The
+  * event id has the watcher epoch, after a restart the client gets the
+  * current state.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <private/watcher.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/intl.h>
+ #include <atomic>
+ #include <mutex>
+ #include <condition_variable>
+ #include <deque>
+ #include <chrono>
+
+ using namespace Udjat;
+ using namespace std;
+ using namespace std::chrono;
+
+ static std::atomic<unsigned int> streams{0};
+
+ bool accepts_event_stream(struct mg_connection *conn) noexcept {
+	const char *accept = mg_get_header(conn, "Accept");
+	return accept && strstr(accept,"text/event-stream");
+ }
+
+ /// @brief Write event, return false if the client is gone.
+ static bool event(struct mg_connection *conn, const CivetWeb::Watcher::Change &change) {
+	string text{"id: "};
+	text += CivetWeb::Watcher::getInstance().token(change.version);
+	text += "\nevent: agent\ndata: ";
+	text += *change.frame;
+	text += "\n\n";
+	return mg_write(conn, text.c_str(), text.size()) > 0;
+ }
+
+ int agentEventStream(struct mg_connection *conn, const char *path) noexcept {
+
+	static const unsigned int max_streams = Config::Value<unsigned int>("agent-updates","max-streams",16);
+
+	if(streams.fetch_add(1) >= max_streams) {
+
+		// Same back off as the long poll limit.
+		streams--;
+
+		static const unsigned int retry = Config::Value<unsigned int>("http-admission","retry-after",1);
+
+		mg_response_header_start(conn, 503);
+		mg_response_header_add(conn, "Retry-After", std::to_string(retry).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_add(conn, "Content-Length", "0", -1);
+		mg_response_header_send(conn);
+
+		return 503;
+
+	}
+
+	CivetWeb::Watcher &watcher = CivetWeb::Watcher::getInstance();
+	unsigned int listener = 0;
+
+	// Pending changes.
+	struct {
+		std::mutex guard;
+		std::condition_variable cond;
+		std::deque<CivetWeb::Watcher::Change> changes;
+	} queue;
+
+	string prefix{CivetWeb::Watcher::prefix(path)};
+
+	try {
+
+		listener = watcher.subscribe([&queue,&prefix](const CivetWeb::Watcher::Change &change){
+			if(CivetWeb::Watcher::match(prefix.c_str(),change.path)) {
+				lock_guard<mutex> lock(queue.guard);
+				queue.changes.push_back(change);
+				queue.cond.notify_one();
+			}
+		});
+
+		// The stream is idle most of the time, don't count it as an active request.
+		park_request();
+
+		mg_response_header_start(conn, 200);
+		mg_response_header_add(conn, "Content-Type", "text/event-stream", -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache", -1);
+		mg_response_header_add(conn, "X-Accel-Buffering", "no", -1);
+		mg_response_header_send(conn);
+
+		bool alive = true;
+
+		{
+			string retry{"retry: "};
+			retry += std::to_string(Config::Value<unsigned int>("agent-updates","retry",1000));
+			retry += "\n\n";
+			alive = mg_write(conn, retry.c_str(), retry.size()) > 0;
+		}
+
+		// Resume from Last-Event-ID or send the current state.
+		const char *last = mg_get_header(conn, "Last-Event-ID");
+		bool resumed = false;
+		uint64_t since = 0;
+		if(alive && watcher.parse(last,since)) {
+			resumed = watcher.replay(since,prefix.c_str(),[conn,&alive](const CivetWeb::Watcher::Change &change){
+				if(alive) {
+					alive = event(conn,change);
+				}
+			});
+		}
+
+		if(alive && !resumed) {
+			watcher.for_each(prefix.c_str(),[conn,&alive](const CivetWeb::Watcher::Agent &agent){
+				if(alive) {
+					CivetWeb::Watcher::Change change;
+					change.version = agent.version;
+					change.path = agent.path;
+					change.frame = agent.frame;
+					alive = event(conn,change);
+				}
+			});
+		}
+
+		auto heartbeat = seconds(Config::Value<unsigned int>("agent-updates","heartbeat",15));
+		auto deadline = steady_clock::now() + seconds(Config::Value<unsigned int>("agent-updates","stream-lifetime",300));
+
+		while(alive && steady_clock::now() < deadline) {
+
+			std::deque<CivetWeb::Watcher::Change> changes;
+			{
+				unique_lock<mutex> lock(queue.guard);
+				if(queue.changes.empty()) {
+					queue.cond.wait_for(lock,heartbeat);
+				}
+				changes.swap(queue.changes);
+			}
+
+			if(changes.empty()) {
+				alive = mg_write(conn, ": heartbeat\n\n", 13) > 0;
+				continue;
+			}
+
+			for(const auto &change : changes) {
+				if(!(alive = event(conn,change))) {
+					break;
+				}
+			}
+
+		}
+
+	} catch(const std::exception &e) {
+
+		Logger::String{"Event stream has failed: ",e.what()}.error("civetweb");
+
+	}
+
+	if(listener) {
+		watcher.unsubscribe(listener);
+	}
+
+	streams--;
+
+	return 200;
+
+ }
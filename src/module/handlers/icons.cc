@@ -29,6 +29,7 @@
  #include <config.h>
  #include <udjat/defs.h>
  #include <private/module.h>
+ #include <private/metrics.h>
  #include <udjat/tools/http/icon.h>
  #include <udjat/tools/http/exception.h>
  #include <udjat/tools/http/mimetype.h>
@@ -44,6 +45,8 @@
 
  int iconWebHandler(struct mg_connection *conn, void UDJAT_UNUSED(*cbdata)) {
 
+ 	CivetWeb::Metrics::begin(CivetWeb::Metrics::Icon);
+
  	debug("Searching for icon",mg_get_request_info(conn)->local_uri);
 
 	try {
@@ -37,7 +37,10 @@
  #include <udjat/tools/logger.h>
 
  #include <private/module.h>
+ #include <private/metrics.h>
  #include <civetweb.h>
+ #include <sys/types.h>
+ #include <sys/stat.h>
 
  #ifdef HAVE_UNISTD_H
 	#include <unistd.h>
@@ -45,6 +48,8 @@
 
  int imageWebHandler(struct mg_connection *conn, void *) {
 
+	CivetWeb::Metrics::begin(CivetWeb::Metrics::Image);
+
 	try {
 
 		const char *path = mg_get_request_info(conn)->local_uri;
@@ -66,6 +71,12 @@
 		if(filename) {
 
 			Logger::String{"Sending static file '", filename.c_str(),"'"}.trace("http");
+
+			struct stat st;
+			if(!stat(filename.c_str(),&st)) {
+				CivetWeb::Metrics::sent(st.st_size);
+			}
+
 			mg_send_file(conn,filename.c_str());
 			return 200;
 
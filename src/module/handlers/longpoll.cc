@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the agent long poll (?wait=<seconds>&since=<version>)
+  *        and the delta responses (?since=<version>).
+  *
+  * Each waiter keeps its civetweb request thread, the waiters are limited
+  * by 'max-waiters'; above it the client gets '503 Service Unavailable'.
+  * While waiting the request is out of the admission limits, it's admitted
+  * again (or rejected with 503) before writing the response.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <private/watcher.h>
+ #include <private/metrics.h>
+ #include <private/admission.h>
+ #include <udjat/tools/http/mimetype.h>
+ #include <udjat/tools/http/timing.h>
+ #include <udjat/tools/configuration.h>
+ #include <atomic>
+ #include <chrono>
+ #include <cstdlib>
+ #include <cstdint>
+
+ using namespace Udjat;
+ using namespace std;
+
+ static std::atomic<unsigned int> waiters{0};
+
+ /// @brief Is the response negotiated as JSON (extension or request headers)? The deltas are JSON only.
+ static bool json(struct mg_connection *conn, const char *path) noexcept {
+
+	const char *slash = strrchr(path,'/');
+	const char *dot = strrchr(slash ? slash : path,'.');
+	if(dot) {
+		return MimeTypeFactory(dot+1,MimeType::custom) == MimeType::json;
+	}
+
+	try {
+		return ((MimeType) CivetWeb::Connection{conn}) == MimeType::json;
+	} catch(...) {
+		return false;
+	}
+
+ }
+
+ int agentWait(struct mg_connection *conn, const char *path) {
+
+	const struct mg_request_info *info = mg_get_request_info(conn);
+
+	if(!(info->query_string && *info->query_string)) {
+		return 0;
+	}
+
+	size_t length = strlen(info->query_string);
+	char buffer[64];
+
+	if(mg_get_var(info->query_string,length,"wait",buffer,sizeof(buffer)) <= 0) {
+		return 0;
+	}
+
+	static const unsigned int max_wait = Config::Value<unsigned int>("agent-updates","max-wait",60);
+	static const unsigned int max_waiters = Config::Value<unsigned int>("agent-updates","max-waiters",32);
+
+	unsigned int seconds = std::min((unsigned int) strtoul(buffer,NULL,10),max_wait);
+
+	CivetWeb::Watcher &watcher = CivetWeb::Watcher::getInstance();
+
+	uint64_t since = 0;
+	if(mg_get_var(info->query_string,length,"since",buffer,sizeof(buffer)) > 0) {
+		if(!json(conn,path)) {
+			// Answered by agentDelta, don't wait for a 406.
+			return http_error(conn, 406, "The agent deltas are only available as JSON");
+		}
+		if(!watcher.parse(buffer,since)) {
+			// Version from another start of the service, answer now.
+			seconds = 0;
+		}
+	} else {
+		since = watcher.last();
+	}
+
+	string prefix{CivetWeb::Watcher::prefix(path)};
+
+	uint64_t version;
+
+	if(seconds) {
+
+		if(waiters.fetch_add(1) >= max_waiters) {
+
+			// Too many waiters, an immediate answer would be polled again at once.
+			waiters--;
+
+			static const unsigned int retry = Config::Value<unsigned int>("http-admission","retry-after",1);
+
+			mg_response_header_start(conn, 503);
+			mg_response_header_add(conn, "Retry-After", std::to_string(retry).c_str(), -1);
+			mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+			mg_response_header_add(conn, "Content-Length", "0", -1);
+			mg_response_header_send(conn);
+
+			return 503;
+
+		}
+
+		// The waiter is idle, keep it out of the admission slots and of the metrics.
+		park_request();
+		version = watcher.wait(prefix.c_str(),since,std::chrono::seconds(seconds));
+		waiters--;
+
+		// A burst of wakeups can't bypass the concurrency limits.
+		int rc = CivetWeb::Admission::getInstance().enter(conn);
+		if(rc) {
+			return rc;
+		}
+
+		// Measure the response only.
+		CivetWeb::Metrics::begin(CivetWeb::Metrics::Root);
+		HTTP::Timing::begin();
+
+	} else {
+
+		version = watcher.last();
+
+	}
+
+	add_response_header("X-Agent-Version",watcher.token(version).c_str());
+
+	return 0;
+
+ }
+
+ int agentDelta(struct mg_connection *conn, const char *path) noexcept {
+
+	const struct mg_request_info *info = mg_get_request_info(conn);
+
+	char buffer[64];
+	if(!(info->query_string && *info->query_string) || mg_get_var(info->query_string,strlen(info->query_string),"since",buffer,sizeof(buffer)) <= 0) {
+		return 0;
+	}
+
+	if(!json(conn,path)) {
+		return http_error(conn, 406, "The agent deltas are only available as JSON");
+	}
+
+	try {
+
+		CivetWeb::Watcher &watcher = CivetWeb::Watcher::getInstance();
+		string prefix{CivetWeb::Watcher::prefix(path)};
+
+		// A token from another start of the service gets all agents.
+		uint64_t since = 0;
+		if(!watcher.parse(buffer,since)) {
+			since = UINT64_MAX;
+		}
+
+		bool full = false;
+		string agents;
+
+		uint64_t version = watcher.delta(since,prefix.c_str(),full,[&agents](const std::string &frame){
+			if(!agents.empty()) {
+				agents += ',';
+			}
+			agents += frame;
+		});
+
+		string token{watcher.token(version)};
+
+		string text{"{\"version\":\""};
+		text += token;
+		text += "\",\"full\":";
+		text += (full ? "true" : "false");
+		text += ",\"agents\":[";
+		text += agents;
+		text += "]}";
+
+		mg_response_header_start(conn, 200);
+		mg_response_header_add(conn, "Content-Type", "application/json; charset=utf-8", -1);
+		mg_response_header_add(conn, "Content-Length", std::to_string(text.size()).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_add(conn, "X-Agent-Version", token.c_str(), -1);
+		mg_response_header_send(conn);
+		mg_write(conn, text.c_str(), text.size());
+
+		return 200;
+
+	} catch(const exception &e) {
+		return http_error(conn, 500, e.what());
+
+	} catch(...) {
+		return http_error(conn, 500, "Unexpected error");
+
+	}
+
+ }
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the pending response handler.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <udjat/tools/http/pending.h>
+ #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/intl.h>
+
+ using namespace Udjat;
+
+ int pendingWebHandler(struct mg_connection *conn, void *) noexcept {
+
+	try {
+
+		// The id is the path component after the (normalized) pending path.
+		const char *uri = mg_get_request_info(conn)->local_uri;
+		std::string path{HTTP::Pending::path()};
+
+		const char *id = nullptr;
+		if(uri && strncmp(uri,path.c_str(),path.size()) == 0) {
+			id = uri + path.size();
+		}
+
+		if(!(id && *id) || strchr(id,'/')) {
+			return http_error(conn, 400, _("Invalid request"));
+		}
+
+		auto pending = HTTP::Pending::find(id);
+		if(!pending) {
+			return http_error(conn, 404, _("Not available"));
+		}
+
+		auto response = pending->response();
+		if(!response) {
+			debug("Response '",id,"' still running");
+			return CivetWeb::Connection{conn}.accepted(pending->location());
+		}
+
+		return send(conn, *response);
+
+	} catch(const HTTP::Exception &e) {
+		return http_error(conn, e.code(), e.what());
+
+	} catch(const system_error &e) {
+		return http_error(conn, HTTP::Exception::code(e), e.what());
+
+	} catch(const exception &e) {
+		return http_error(conn, 500, e.what());
+
+	} catch(...) {
+		return http_error(conn, 500, "Unexpected error");
+
+	}
+
+ }
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the request pool and admission counters output.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <private/pool.h>
+ #include <private/admission.h>
+ #include <private/ratelimit.h>
+ #include <private/accesslog.h>
+ #include <private/client.h>
+ #include <private/engine.h>
+ #include <private/resolver.h>
+ #include <private/tlscache.h>
+ #include <private/httpcache.h>
+ #include <udjat/tools/http/value.h>
+ #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/intl.h>
+
+ using namespace Udjat;
+
+ int poolWebHandler(struct mg_connection *conn, void *) noexcept {
+
+	if(!status_allowed(conn)) {
+		return http_error(conn, 403, "Forbidden");
+	}
+
+	try {
+
+		MimeType mimetype{MimeTypeFactory(conn,MimeType::json)};
+
+		HTTP::Value response{Value::Object};
+		CivetWeb::Pool::getInstance().get(response);
+		CivetWeb::Admission::getInstance().get(response["admission"]);
+		CivetWeb::RateLimiter::getInstance().get(response["rate-limit"]);
+		CivetWeb::AccessLog::getInstance().get(response["access-log"]);
+		CivetWeb::SessionPool::getInstance().get(response["client"]);
+		CivetWeb::Engine::getInstance().get(response["engine"]);
+		CivetWeb::Resolver::getInstance().get(response["dns"]);
+		CivetWeb::TLSCache::getInstance().get(response["tls"]);
+		CivetWeb::HttpCache::getInstance().get(response["cache"]);
+
+		string text{response.to_string(mimetype)};
+
+		mg_response_header_start(conn, 200);
+		mg_response_header_add(conn, "Content-Type",std::to_string(mimetype),-1);
+		mg_response_header_add(conn, "Content-Length", std::to_string(text.size()).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_send(conn);
+		mg_write(conn, text.c_str(), text.size());
+
+		return 200;
+
+	} catch(const HTTP::Exception &e) {
+		return http_error(conn, e.code(), e.what());
+
+	} catch(const system_error &e) {
+		return http_error(conn, HTTP::Exception::code(e), e.what());
+
+	} catch(const exception &e) {
+		return http_error(conn, 500, e.what());
+
+	} catch(...) {
+		return http_error(conn, 500, "Unexpected error");
+
+	}
+
+ }
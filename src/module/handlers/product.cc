@@ -25,10 +25,13 @@
  #include <config.h>
  #include <udjat/defs.h>
  #include <private/module.h>
+ #include <private/metrics.h>
  #include <udjat/tools/logger.h>
  #include <udjat/tools/application.h>
  #include <udjat/tools/intl.h>
  #include <stdexcept>
+ #include <sys/types.h>
+ #include <sys/stat.h>
 
  #ifdef HAVE_UNISTD_H
 	#include <unistd.h>
@@ -39,6 +42,8 @@
 
  int productWebHandler(struct mg_connection *conn, void *) noexcept {
 
+	CivetWeb::Metrics::begin(CivetWeb::Metrics::Product);
+
 	try {
 
 		static const char *prefix = "/" STRINGIZE_VALUE_OF(PRODUCT_NAME) "/";
@@ -62,6 +67,12 @@
 		if(filename) {
 
 			Logger::String{"Sending static file '", filename.c_str(),"'"}.trace("http");
+
+			struct stat st;
+			if(!stat(filename.c_str(),&st)) {
+				CivetWeb::Metrics::sent(st.st_size);
+			}
+
 			mg_send_file(conn,filename.c_str());
 			return 200;
 
@@ -36,14 +36,39 @@
  #include <udjat/tools/configuration.h>
  #include <udjat/tools/worker.h>
  #include <private/request.h>
+ #include <private/metrics.h>
+ #include <private/watcher.h>
+ #include <udjat/tools/http/timing.h>
 
  using namespace std;
  using namespace Udjat;
 
  int rootWebHandler(struct mg_connection *conn, void *) noexcept {
 
+	CivetWeb::Metrics::begin(CivetWeb::Metrics::Root);
+	HTTP::Timing::begin();
+
 	try {
 
+		const char *path = CivetWeb::Watcher::path(mg_get_request_info(conn)->local_uri);
+		if(path) {
+
+			if(accepts_event_stream(conn)) {
+				return agentEventStream(conn,path);
+			}
+
+			int rc = agentWait(conn,path);
+			if(rc) {
+				return rc;
+			}
+
+			rc = agentDelta(conn,path);
+			if(rc) {
+				return rc;
+			}
+
+		}
+
 		CivetWeb::Connection connection{conn};
 		return CivetWeb::Request{conn}.exec(connection);
 
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the agent snapshot output.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <private/watcher.h>
+ #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/intl.h>
+
+ using namespace Udjat;
+
+ int snapshotWebHandler(struct mg_connection *conn, void *) noexcept {
+
+	try {
+
+		CivetWeb::Watcher &watcher = CivetWeb::Watcher::getInstance();
+
+		uint64_t version = 0;
+		auto document = watcher.snapshot(version);
+
+		if(!document) {
+			return http_error(conn, 503, _("Agent snapshot is not available"));
+		}
+
+		// The versions restart with the service, the token has the watcher epoch.
+		string etag{"\""};
+		etag += watcher.token(version);
+		etag += "\"";
+
+		if(etag_match(mg_get_header(conn, "If-None-Match"),etag.c_str())) {
+			mg_response_header_start(conn, 304);
+			mg_response_header_add(conn, "ETag", etag.c_str(), -1);
+			mg_response_header_send(conn);
+			return 304;
+		}
+
+		mg_response_header_start(conn, 200);
+		mg_response_header_add(conn, "Content-Type", "application/json; charset=utf-8", -1);
+		mg_response_header_add(conn, "Content-Length", std::to_string(document->size()).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache", -1);
+		mg_response_header_add(conn, "ETag", etag.c_str(), -1);
+		mg_response_header_send(conn);
+		mg_write(conn, document->c_str(), document->size());
+
+		return 200;
+
+	} catch(const HTTP::Exception &e) {
+		return http_error(conn, e.code(), e.what());
+
+	} catch(const system_error &e) {
+		return http_error(conn, HTTP::Exception::code(e), e.what());
+
+	} catch(const exception &e) {
+		return http_error(conn, 500, e.what());
+
+	} catch(...) {
+		return http_error(conn, 500, "Unexpected error");
+
+	}
+
+ }
@@ -0,0 +1,288 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the agent updates websocket.
+  *
+  * Clients send 'subscribe <agent path>' or 'unsubscribe <agent path>'
+  * text messages ('/' for all agents); after subscribing they get the
+  * current state of the agents and one frame for each change.
+  *
+  * Frames are queued by connection and written by one writer thread,
+  * the watcher and the client locks are never held while writing. A
+  * client with too many queued frames is closed.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <private/watcher.h>
+ #include <udjat/tools/logger.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <memory>
+ #include <map>
+ #include <list>
+ #include <deque>
+ #include <vector>
+ #include <string>
+
+ using namespace Udjat;
+ using namespace std;
+
+ namespace {
+
+	/// @brief Websocket client.
+	struct Client {
+		std::list<std::string> paths;
+
+		/// @brief Frames waiting for the writer (nullptr closes the connection).
+		std::deque<std::shared_ptr<const std::string>> queue;
+
+		/// @brief Queue was full, the connection is closing.
+		bool overflow = false;
+
+		/// @brief Held while writing, the close callback waits for it.
+		std::mutex writing;
+		bool closed = false;
+	};
+
+	/// @brief Frames queued by client before closing it.
+	static const size_t max_queued = 1024;
+
+	std::mutex guard;
+
+	/// @brief Signaled when a frame is queued.
+	std::condition_variable pending;
+
+	/// @brief Connected clients.
+	std::map<const struct mg_connection *,std::shared_ptr<Client>> clients;
+
+	/// @brief Watcher listener id (0 when no clients).
+	unsigned int listener = 0;
+
+	/// @brief The writer thread, running while there are clients.
+	std::thread *writer = nullptr;
+	bool running = false;
+
+	/// @brief Writer generation, a stopped writer may still be finishing when the next one starts.
+	unsigned int generation = 0;
+
+	/// @brief Queue frame, the guard must be locked.
+	void enqueue(Client &client, const std::shared_ptr<const std::string> &frame) {
+
+		if(client.overflow) {
+			return;
+		}
+
+		if(client.queue.size() >= max_queued) {
+			// Slow client, close it; it will resubscribe and get the current state.
+			client.queue.clear();
+			client.queue.push_back(std::shared_ptr<const std::string>());
+			client.overflow = true;
+		} else {
+			client.queue.push_back(frame);
+		}
+
+		pending.notify_one();
+
+	}
+
+	void write(struct mg_connection *conn, const std::shared_ptr<const std::string> &frame) {
+		mg_lock_connection(conn);
+		if(frame) {
+			mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, frame->c_str(), frame->size());
+		} else {
+			mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE, "", 0);
+		}
+		mg_unlock_connection(conn);
+	}
+
+	void run(unsigned int id) {
+
+		unique_lock<mutex> lock(guard);
+
+		while(running && id == generation) {
+
+			std::vector<std::pair<struct mg_connection *,std::shared_ptr<Client>>> ready;
+			for(auto &it : clients) {
+				if(!it.second->queue.empty()) {
+					ready.emplace_back((struct mg_connection *) it.first,it.second);
+				}
+			}
+
+			if(ready.empty()) {
+				pending.wait(lock);
+				continue;
+			}
+
+			for(auto &it : ready) {
+
+				std::deque<std::shared_ptr<const std::string>> frames;
+				frames.swap(it.second->queue);
+
+				lock.unlock();
+				{
+					lock_guard<mutex> writing(it.second->writing);
+					if(!it.second->closed) {
+						for(const auto &frame : frames) {
+							write(it.first,frame);
+						}
+					}
+				}
+				lock.lock();
+
+			}
+
+		}
+
+	}
+
+	void changed(const CivetWeb::Watcher::Change &change) {
+
+		lock_guard<mutex> lock(guard);
+
+		for(auto &it : clients) {
+			for(const std::string &path : it.second->paths) {
+				if(CivetWeb::Watcher::match(path.c_str(),change.path)) {
+					enqueue(*it.second,change.frame);
+					break;
+				}
+			}
+		}
+
+	}
+
+ }
+
+ int agentWebSocketConnect(const struct mg_connection *conn, void *) {
+
+	lock_guard<mutex> lock(guard);
+
+	clients[conn] = make_shared<Client>();
+
+	if(!listener) {
+		listener = CivetWeb::Watcher::getInstance().subscribe(changed);
+	}
+
+	if(!writer) {
+		running = true;
+		writer = new std::thread(run,++generation);
+	}
+
+	return 0;
+
+ }
+
+ void agentWebSocketReady(struct mg_connection *, void *) {
+ }
+
+ int agentWebSocketData(struct mg_connection *conn, int bits, char *data, size_t length, void *) {
+
+	int opcode = bits & 0x0f;
+
+	if(opcode == MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE) {
+		return 0;
+	}
+
+	if(opcode != MG_WEBSOCKET_OPCODE_TEXT) {
+		return 1;
+	}
+
+	string message{data,length};
+	while(!message.empty() && isspace(message.back())) {
+		message.pop_back();
+	}
+
+	bool subscribe = true;
+	if(!strncasecmp(message.c_str(),"subscribe ",10)) {
+		message.erase(0,10);
+	} else if(!strncasecmp(message.c_str(),"unsubscribe ",12)) {
+		message.erase(0,12);
+		subscribe = false;
+	}
+
+	lock_guard<mutex> lock(guard);
+
+	auto client = clients.find(conn);
+	if(client == clients.end()) {
+		return 0;
+	}
+
+	client->second->paths.remove(message);
+
+	if(subscribe) {
+
+		client->second->paths.push_back(message);
+
+		// Queue the current state, the changes after it are queued by the listener.
+		Client &target = *client->second;
+		CivetWeb::Watcher::getInstance().for_each(message.c_str(),[&target](const CivetWeb::Watcher::Agent &agent){
+			enqueue(target,agent.frame);
+		});
+
+	}
+
+	return 1;
+
+ }
+
+ void agentWebSocketClose(const struct mg_connection *conn, void *) {
+
+	unsigned int id = 0;
+	std::thread *stopped = nullptr;
+	std::shared_ptr<Client> client;
+
+	{
+		lock_guard<mutex> lock(guard);
+
+		auto it = clients.find(conn);
+		if(it != clients.end()) {
+			client = it->second;
+			clients.erase(it);
+		}
+
+		if(clients.empty()) {
+			id = listener;
+			listener = 0;
+			stopped = writer;
+			writer = nullptr;
+			running = false;
+			pending.notify_all();
+		}
+	}
+
+	if(client) {
+		// Wait for the writer, the connection is released after this callback.
+		lock_guard<mutex> writing(client->writing);
+		client->closed = true;
+	}
+
+	if(stopped) {
+		stopped->join();
+		delete stopped;
+	}
+
+	if(id) {
+		CivetWeb::Watcher::getInstance().unsubscribe(id);
+	}
+
+ }
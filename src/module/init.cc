@@ -29,18 +29,43 @@
  #include <udjat/tools/expander.h>
  #include <udjat/tools/http/server.h>
  #include <udjat/tools/http/handler.h>
+ #include <udjat/tools/http/timing.h>
+ #include <udjat/tools/http/pending.h>
  #include <udjat/tools/logger.h>
  #include <udjat/tools/string.h>
  #include <udjat/tools/worker.h>
  #include <udjat/module/abstract.h>
  #include <unistd.h>
+ #include <algorithm>
+ #include <cctype>
+ #include <thread>
+
+ #ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+ #endif // __linux__
 
  #include <private/module.h>
+ #include <private/pool.h>
+ #include <private/admission.h>
+ #include <private/ratelimit.h>
+ #include <private/metrics.h>
+ #include <private/accesslog.h>
+ #include <private/slowlog.h>
+ #include <private/watcher.h>
+ #include <private/client.h>
+ #include <private/engine.h>
+ #include <private/resolver.h>
+ #include <private/tlscache.h>
+ #include <private/httpcache.h>
 
  using namespace Udjat;
  using namespace std;
 
  static int log_message(const struct mg_connection *conn, const char *message);
+ static int begin_request(struct mg_connection *conn);
+ static void end_request(const struct mg_connection *conn, int reply_status_code);
+ static void * init_thread(const struct mg_context *ctx, int thread_type);
 
  const Udjat::ModuleInfo udjat_module_info{ "CivetWEB " CIVETWEB_VERSION " HTTP module for " STRINGIZE_VALUE_OF(PRODUCT_NAME) };
 
@@ -71,20 +96,45 @@
  };
 
 
- class Module : public Udjat::Module, public Service, public HTTP::Server {
- private:
+ /// @brief Civetweb context, one for each shard.
+ struct Shard {
 	struct mg_context *ctx = nullptr;
 
+	/// @brief CPU list for the shard threads ("0-3,8").
+	string cpus;
+ };
+
+ class Module : public Udjat::Module, public Service, public HTTP::Server, public CivetWeb::Fetcher {
+ private:
+	std::list<Shard> shards;
+
 	struct {
 		CivetWeb::Protocol http{"http",udjat_module_info};
 		CivetWeb::Protocol https{"https",udjat_module_info};
 	} protocols;
 
-	void setHandlers() noexcept {
+	void setHandlers(struct mg_context *ctx) noexcept {
 		mg_set_request_handler(ctx, "/icon/", iconWebHandler, 0);
 		mg_set_request_handler(ctx, "/" STRINGIZE_VALUE_OF(PRODUCT_NAME) "/", productWebHandler, 0);
 		mg_set_request_handler(ctx, "/image/", imageWebHandler, 0);
 		mg_set_request_handler(ctx, "/favicon.ico", faviconWebHandler, 0);
+		mg_set_request_handler(ctx, HTTP::Pending::path().c_str(), pendingWebHandler, 0);
+		mg_set_request_handler(ctx, Config::Value<string>("civetweb","pool-path","/civetweb/pool").c_str(), poolWebHandler, 0);
+		mg_set_request_handler(ctx, Config::Value<string>("civetweb","metrics-path","/metrics").c_str(), metricsWebHandler, 0);
+		mg_set_request_handler(ctx, Config::Value<string>("civetweb","slow-requests-path","/civetweb/slow").c_str(), slowWebHandler, 0);
+		mg_set_request_handler(ctx, Config::Value<string>("agent-updates","snapshot-path","/api/snapshot").c_str(), snapshotWebHandler, 0);
+
+		if(mg_check_feature(MG_FEATURES_WEBSOCKET)) {
+			mg_set_websocket_handler(
+				ctx,
+				Config::Value<string>("agent-updates","websocket-path","/api/agent-updates").c_str(),
+				agentWebSocketConnect,
+				agentWebSocketReady,
+				agentWebSocketData,
+				agentWebSocketClose,
+				0
+			);
+		}
 
 #ifdef HAVE_LIBSSL
 		mg_set_request_handler(ctx, "/pubkey.pem", keyWebHandler, 0);
@@ -104,6 +154,9 @@
 		memset(&callbacks,0,sizeof(callbacks));
 		callbacks.log_message = log_message;
 		callbacks.http_error = http_error;
+		callbacks.begin_request = begin_request;
+		callbacks.end_request = end_request;
+		callbacks.init_thread = init_thread;
 	}
 
 	void initialize(std::vector<string> &optionlist) {
@@ -124,19 +177,67 @@
 
 		// https://github.com/civetweb/civetweb/blob/master/docs/api/mg_start.md
 
+		// Get the request thread count (civetweb default is 50).
+		unsigned int threads = 50;
+		bool has_threads = false;
+		for(size_t ix = 0; ix+1 < optionlist.size(); ix += 2) {
+			if(!strcasecmp(optionlist[ix].c_str(),"num_threads")) {
+				const char *value = optionlist[ix+1].c_str();
+				char *end = nullptr;
+				unsigned long number = strtoul(value,&end,10);
+				if(!isdigit(*value) || *end || !number || number > 65535) {
+					Udjat::Module::error() << "Cannot start: civetweb-options/num_threads is '" << value << "', expecting a thread count from 1 to 65535." << endl;
+					return;
+				}
+				threads = (unsigned int) number;
+				has_threads = true;
+			}
+		}
+
+		if(!has_threads && Config::Value<bool>("civetweb","concurrency-limit",false)) {
+
+			// With the concurrency limit civetweb starts with the upper bound, the controller keeps the active handlers.
+			threads = Config::Value<unsigned int>("civetweb","concurrency-max",threads);
+			if(!optionlist.empty()) {
+				optionlist.emplace_back("num_threads");
+				optionlist.emplace_back(std::to_string(threads));
+			}
+
+		}
+
+		unsigned int count = std::max((unsigned int) Config::Value<unsigned int>("civetweb","shards",1),1U);
+#ifndef HAVE_CIVETWEB_REUSEPORT
+		if(count > 1) {
+			Logger::String{"Ignoring civetweb/shards, the shards can't share the listening ports without a civetweb using SO_REUSEPORT (configure --enable-shards)"}.warning("civetweb");
+			count = 1;
+		}
+#endif // HAVE_CIVETWEB_REUSEPORT
+		CivetWeb::Pool::getInstance().setup(threads * count);
+		CivetWeb::Admission::getInstance().setup();
+		CivetWeb::RateLimiter::getInstance().setup();
+		CivetWeb::AccessLog::getInstance().setup();
+		CivetWeb::SlowLog::getInstance().setup();
+		CivetWeb::SessionPool::getInstance().setup();
+		CivetWeb::Resolver::getInstance().setup();
+		CivetWeb::TLSCache::getInstance().setup();
+		CivetWeb::HttpCache::getInstance().setup();
+
 		if(optionlist.empty()) {
 
 			// Use default options
 			cerr << "civetweb\tNo civetweb configuration, using defaults" << endl;
 
-			static const char *options[] = {
+			string num_threads{std::to_string(threads)};
+
+			const char *options[] = {
 				"listening_ports","localhost:8989",
 				"request_timeout_ms","10000",
 				"enable_auth_domain_check","no",
+				"num_threads",num_threads.c_str(),
 				NULL
 			};
 
-			ctx = mg_start(&callbacks, this, options);
+			launch(callbacks, options, count);
 
 		} else {
 
@@ -163,24 +264,86 @@
 			}
 			options[ix] = NULL;
 
-			ctx = mg_start(&callbacks, this, options);
+			launch(callbacks, options, count);
 			delete[] options;
 
 
 		}
 
-		if (ctx == NULL) {
+		if (shards.empty()) {
 			Udjat::Module::error() << "Cannot start: mg_start failed." << endl;
 			return;
 		}
 
-		setHandlers();
+		if(shards.size() != count) {
+			// Size the pool from the shards running.
+			CivetWeb::Pool::getInstance().setup(threads * shards.size());
+		}
+
+		for(Shard &shard : shards) {
+			setHandlers(shard.ctx);
+		}
+
+	}
+
+	/// @brief Start civetweb contexts.
+	/// @param count The number of shards, all of them bound to the same ports.
+	void launch(struct mg_callbacks &callbacks, const char **options, unsigned int count) {
+
+		std::vector<string> cpus;
+		{
+			Config::Value<string> config{"civetweb","shard-cpus",""};
+			if(count > 1 && !strcasecmp(config.c_str(),"auto")) {
+
+				// Split the online CPUs between the shards.
+				unsigned int online = std::max(std::thread::hardware_concurrency(),1U);
+				unsigned int step = std::max(online / count,1U);
+				for(unsigned int ix = 0; ix < count; ix++) {
+					unsigned int first = (ix * step) % online;
+					cpus.push_back(std::to_string(first) + "-" + std::to_string(std::min(first+step,online)-1));
+				}
+
+			} else if(!config.empty()) {
+
+				for(const String &cpu : String{config.c_str()}.split(";")) {
+					cpus.push_back(cpu.c_str());
+				}
+
+			}
+		}
+
+		for(unsigned int ix = 0; ix < count; ix++) {
+
+			shards.emplace_back();
+			Shard &shard = shards.back();
+
+			if(!cpus.empty()) {
+				shard.cpus = cpus[ix % cpus.size()];
+			}
+
+			shard.ctx = mg_start(&callbacks, &shard, options);
+
+			if(!shard.ctx) {
+				shards.pop_back();
+				if(ix) {
+					// The next ones will fail on the same ports.
+					Logger::String{"Cant start shard ",ix,", civetweb must bind the listening ports with SO_REUSEPORT; running with ",ix," shard(s)"}.error("civetweb");
+					break;
+				}
+				continue;
+			}
+
+			if(count > 1) {
+				Logger::String{"Shard ",ix," started",(shard.cpus.empty() ? "" : " on CPUs "),shard.cpus}.info("civetweb");
+			}
+
+		}
 
 	}
 
  public:
 
- 	Module(const pugi::xml_node &node) : Udjat::Module("httpd",udjat_module_info), Service(udjat_module_info), ctx(NULL) {
+ 	Module(const pugi::xml_node &node) : Udjat::Module("httpd",udjat_module_info), Service(udjat_module_info) {
 
 		unsigned int init = 0;
 
@@ -219,7 +382,7 @@
 
  	}
 
- 	Module() : Udjat::Module("httpd",udjat_module_info), Service(udjat_module_info), ctx(NULL) {
+ 	Module() : Udjat::Module("httpd",udjat_module_info), Service(udjat_module_info) {
 
  		unsigned int init = 0;
 
@@ -247,9 +410,18 @@
 
 		cout << "civetweb\tStopping service" << endl;
 
-		if(ctx) {
-			mg_stop(ctx);
+		for(Shard &shard : shards) {
+			mg_stop(shard.ctx);
 		}
+		shards.clear();
+
+		CivetWeb::Watcher::getInstance().stop();
+		CivetWeb::AccessLog::getInstance().stop();
+		CivetWeb::Engine::getInstance().stop();
+		CivetWeb::Resolver::getInstance().stop();
+		CivetWeb::SessionPool::getInstance().clear();
+		CivetWeb::TLSCache::getInstance().clear();
+		CivetWeb::HttpCache::getInstance().clear();
 
 		mg_exit_library();
 
@@ -257,9 +429,15 @@
 
 	void start() noexcept override {
 
+		// The agent updates start the watcher when used, the index page cache needs it now.
+		if(Config::Value<bool>("http","index-cache",false)) {
+			CivetWeb::Watcher::getInstance().start();
+		}
+
 		struct mg_server_port ports[10];
 
-		int count = mg_get_server_ports(ctx,10,ports);
+		// All shards share the same ports.
+		int count = (shards.empty() ? 0 : mg_get_server_ports(shards.front().ctx,10,ports));
 		if(count > 0) {
 
 			for(int ix = 0; ix < count;ix++) {
@@ -337,12 +515,18 @@
 			uri.resize(uri.size()-1);
 		}
 
-		mg_set_request_handler(ctx, uri.c_str(), customWebHandler, handler);
+		for(Shard &shard : shards) {
+			mg_set_request_handler(shard.ctx, uri.c_str(), customWebHandler, handler);
+		}
+
+		if(handler->concurrency()) {
+			CivetWeb::Admission::getInstance().set(uri.c_str(),handler->concurrency());
+		}
 
 		if(Logger::enabled(Logger::Trace)) {
 
 			struct mg_server_port ports[10];
-			if(mg_get_server_ports(ctx,10,ports) > 0) {
+			if(!shards.empty() && mg_get_server_ports(shards.front().ctx,10,ports) > 0) {
 
 				Logger::String{
 					"New request handler was activated on ",
@@ -372,12 +556,27 @@
 			uri.resize(uri.size()-1);
 		}
 
-		mg_set_request_handler(ctx, uri.c_str(), NULL, NULL);
+		for(Shard &shard : shards) {
+			mg_set_request_handler(shard.ctx, uri.c_str(), NULL, NULL);
+		}
+
+		if(handler->concurrency()) {
+			CivetWeb::Admission::getInstance().set(uri.c_str(),0);
+		}
 		Logger::String{"Custom handler for '",handler->c_str(),"' removed"}.info("civetweb");
 
 		return true;
 	}
 
+	std::vector<CivetWeb::Result> get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout) override {
+		return CivetWeb::Engine::getInstance().get(urls,timeout);
+	}
+
+	void get(const char *url, const std::function<void(const CivetWeb::Result &result)> &callback, const std::chrono::milliseconds &timeout) override {
+		CivetWeb::Worker worker{url};
+		CivetWeb::Engine::getInstance().push(worker,callback,timeout);
+	}
+
  };
 
  /// @brief Register udjat module.
@@ -389,10 +588,77 @@
 	return new ::Module(node);
  }
 
+ int begin_request(struct mg_connection *conn) {
+
+	CivetWeb::AccessLog::begin();
+
+	int rc = CivetWeb::RateLimiter::getInstance().check(conn);
+	if(rc) {
+		return rc;
+	}
+
+	return CivetWeb::Admission::getInstance().enter(conn);
+ }
+
+ void end_request(const struct mg_connection *conn, int reply_status_code) {
+	CivetWeb::AccessLog::getInstance().push(conn,reply_status_code,CivetWeb::Metrics::sent());
+	CivetWeb::SlowLog::getInstance().push(conn,reply_status_code,CivetWeb::Metrics::sent());
+	CivetWeb::Metrics::getInstance().end(conn,reply_status_code);
+	HTTP::Timing::end();
+	clear_response_headers();
+	CivetWeb::Admission::getInstance().leave();
+ }
+
+ void park_request() noexcept {
+	CivetWeb::Metrics::cancel();
+	HTTP::Timing::cancel();
+	CivetWeb::Admission::getInstance().leave();
+ }
+
+ void * init_thread(const struct mg_context *ctx, int thread_type) {
+
+#ifdef __linux__
+	// Pin the request threads (type 1) of the shard.
+	const Shard *shard = (const Shard *) mg_get_user_data(ctx);
+	if(thread_type == 1 && shard && !shard->cpus.empty()) {
+
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+
+		for(const String &range : String{shard->cpus.c_str()}.split(",")) {
+			int from = 0, to = 0;
+			switch(sscanf(range.c_str(),"%d-%d",&from,&to)) {
+			case 1:
+				to = from;
+				// fallthrough
+			case 2:
+				for(int cpu = from; cpu <= to && cpu < CPU_SETSIZE; cpu++) {
+					CPU_SET(cpu,&cpus);
+				}
+				break;
+			default:
+				Logger::String{"Invalid CPU range '",range.c_str(),"'"}.error("civetweb");
+			}
+		}
+
+		int rc = pthread_setaffinity_np(pthread_self(),sizeof(cpus),&cpus);
+		if(rc) {
+			Logger::String{"Cant pin thread to CPUs ",shard->cpus.c_str(),": ",strerror(rc)}.error("civetweb");
+		}
+
+	}
+#else
+	(void) ctx;
+	(void) thread_type;
+#endif // __linux__
+
+	return NULL;
+ }
+
  #pragma GCC diagnostic push
  #pragma GCC diagnostic ignored "-Wunused-parameter"
  int log_message(const struct mg_connection *conn, const char *message) {
-	clog << "civetweb\t" << message << endl;
+	CivetWeb::AccessLog::getInstance().push(message);
 	return 1;
  }
  #pragma GCC diagnostic pop
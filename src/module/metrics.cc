@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the request metrics.
+  *
+  * Each request thread updates its own counters without locks; the
+  * scrape merges the thread counters with the ones from the finished
+  * threads.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/metrics.h>
+ #include <udjat/tools/http/timing.h>
+ #include <chrono>
+ #include <sstream>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	static const char * route_names[CivetWeb::Metrics::RouteCount] = {
+		"root",
+		"custom",
+		"product",
+		"icon",
+		"image"
+	};
+
+	/// @brief The request running on this thread.
+	static thread_local struct {
+		int route = -1;
+		steady_clock::time_point started;
+		uint64_t sent = 0;
+	} current;
+
+	static inline void add(std::atomic<uint64_t> &counter, uint64_t value) noexcept {
+		// Single writer, no need for a locked add.
+		counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+	}
+
+	CivetWeb::Metrics::Counters::Counters() {
+		for(auto &status : this->status) {
+			status = 0;
+		}
+		for(auto &bucket : buckets) {
+			bucket = 0;
+		}
+	}
+
+	CivetWeb::Metrics::Metrics() {
+	}
+
+	CivetWeb::Metrics & CivetWeb::Metrics::getInstance() {
+		static Metrics instance;
+		return instance;
+	}
+
+	CivetWeb::Metrics::Shard & CivetWeb::Metrics::shard() {
+
+		struct Registration {
+			Shard shard;
+
+			Registration() {
+				Metrics &metrics = Metrics::getInstance();
+				lock_guard<mutex> lock(metrics.guard);
+				metrics.shards.push_back(&shard);
+			}
+
+			~Registration() {
+				Metrics &metrics = Metrics::getInstance();
+				lock_guard<mutex> lock(metrics.guard);
+				metrics.shards.remove(&shard);
+				for(unsigned int route = 0; route < RouteCount; route++) {
+					merge(metrics.retired.routes[route],shard.routes[route]);
+				}
+			}
+
+		};
+
+		static thread_local Registration registration;
+		return registration.shard;
+
+	}
+
+	void CivetWeb::Metrics::merge(Counters &to, const Counters &from) noexcept {
+
+		to.requests += from.requests.load(memory_order_relaxed);
+		to.received += from.received.load(memory_order_relaxed);
+		to.sent += from.sent.load(memory_order_relaxed);
+		to.sum += from.sum.load(memory_order_relaxed);
+
+		for(unsigned int ix = 0; ix < StatusCount; ix++) {
+			to.status[ix] += from.status[ix].load(memory_order_relaxed);
+		}
+
+		for(unsigned int ix = 0; ix < BucketCount; ix++) {
+			to.buckets[ix] += from.buckets[ix].load(memory_order_relaxed);
+		}
+
+	}
+
+	unsigned int CivetWeb::Metrics::bucket(uint64_t usec) noexcept {
+
+		if(usec < 4) {
+			return (unsigned int) usec;
+		}
+
+		unsigned int msb = 0;
+		for(uint64_t value = usec; value > 1; value >>= 1) {
+			msb++;
+		}
+
+		unsigned int ix = ((msb-1) * 4) + ((usec >> (msb-2)) & 3);
+		return (ix < BucketCount ? ix : BucketCount-1);
+
+	}
+
+	uint64_t CivetWeb::Metrics::limit(unsigned int bucket) noexcept {
+
+		if(bucket < 4) {
+			return bucket+1;
+		}
+
+		unsigned int msb = (bucket / 4) + 1;
+		return ((uint64_t) (5 + (bucket % 4))) << (msb-2);
+
+	}
+
+	void CivetWeb::Metrics::begin(const Route route) noexcept {
+		current.route = (int) route;
+		current.started = steady_clock::now();
+		current.sent = 0;
+	}
+
+	void CivetWeb::Metrics::sent(uint64_t bytes) noexcept {
+		current.sent += bytes;
+	}
+
+	uint64_t CivetWeb::Metrics::sent() noexcept {
+		return current.sent;
+	}
+
+	void CivetWeb::Metrics::cancel() noexcept {
+		current.route = -1;
+	}
+
+	void CivetWeb::Metrics::end(const struct mg_connection *conn, int status) noexcept {
+
+		if(current.route < 0) {
+			current.sent = 0;
+			return;
+		}
+
+		uint64_t usec = duration_cast<microseconds>(steady_clock::now() - current.started).count();
+
+		try {
+
+			Counters &counters = shard().routes[current.route];
+
+			add(counters.requests,1);
+			add(counters.status[(status >= 100 && status < 600) ? (status / 100) : 0],1);
+			add(counters.sent,current.sent);
+			add(counters.sum,usec);
+			add(counters.buckets[bucket(usec)],1);
+
+			const struct mg_request_info *info = mg_get_request_info(conn);
+			if(info && info->content_length > 0) {
+				add(counters.received,(uint64_t) info->content_length);
+			}
+
+		} catch(...) {
+			// Can't register thread, ignore the request.
+		}
+
+		current.route = -1;
+		current.sent = 0;
+
+	}
+
+	std::string CivetWeb::Metrics::to_string() {
+
+		Shard total;
+
+		{
+			lock_guard<mutex> lock(guard);
+			for(unsigned int route = 0; route < RouteCount; route++) {
+				merge(total.routes[route],retired.routes[route]);
+				for(const Shard *shard : shards) {
+					merge(total.routes[route],shard->routes[route]);
+				}
+			}
+		}
+
+		std::stringstream out;
+		out.precision(10);
+
+		out	<< "# HELP udjat_http_requests_total Requests handled." << endl
+			<< "# TYPE udjat_http_requests_total counter" << endl;
+		for(unsigned int route = 0; route < RouteCount; route++) {
+			out << "udjat_http_requests_total{route=\"" << route_names[route] << "\"} " << total.routes[route].requests << endl;
+		}
+
+		out	<< "# HELP udjat_http_responses_total Responses by status class." << endl
+			<< "# TYPE udjat_http_responses_total counter" << endl;
+		for(unsigned int route = 0; route < RouteCount; route++) {
+			for(unsigned int ix = 0; ix < StatusCount; ix++) {
+				out << "udjat_http_responses_total{route=\"" << route_names[route] << "\",class=\"";
+				if(ix) {
+					out << ix << "xx";
+				} else {
+					out << "other";
+				}
+				out << "\"} " << total.routes[route].status[ix] << endl;
+			}
+		}
+
+		out	<< "# HELP udjat_http_request_bytes_total Request body bytes." << endl
+			<< "# TYPE udjat_http_request_bytes_total counter" << endl;
+		for(unsigned int route = 0; route < RouteCount; route++) {
+			out << "udjat_http_request_bytes_total{route=\"" << route_names[route] << "\"} " << total.routes[route].received << endl;
+		}
+
+		out	<< "# HELP udjat_http_response_bytes_total Response body bytes." << endl
+			<< "# TYPE udjat_http_response_bytes_total counter" << endl;
+		for(unsigned int route = 0; route < RouteCount; route++) {
+			out << "udjat_http_response_bytes_total{route=\"" << route_names[route] << "\"} " << total.routes[route].sent << endl;
+		}
+
+		// Export the histogram on the power of 2 limits, they are aligned with the internal buckets.
+		out	<< "# HELP udjat_http_request_duration_seconds Request latency." << endl
+			<< "# TYPE udjat_http_request_duration_seconds histogram" << endl;
+		for(unsigned int route = 0; route < RouteCount; route++) {
+
+			const Counters &counters = total.routes[route];
+			uint64_t count = 0;
+
+			for(unsigned int ix = 0; ix < BucketCount; ix++) {
+				count += counters.buckets[ix];
+				if(ix >= 7 && (ix % 4) == 3 && ix < BucketCount-1) {
+					out << "udjat_http_request_duration_seconds_bucket{route=\"" << route_names[route] << "\",le=\""
+						<< (((double) limit(ix)) / 1000000.0) << "\"} " << count << endl;
+				}
+			}
+
+			out << "udjat_http_request_duration_seconds_bucket{route=\"" << route_names[route] << "\",le=\"+Inf\"} " << count << endl;
+			out << "udjat_http_request_duration_seconds_sum{route=\"" << route_names[route] << "\"} " << (((double) counters.sum) / 1000000.0) << endl;
+			out << "udjat_http_request_duration_seconds_count{route=\"" << route_names[route] << "\"} " << count << endl;
+
+		}
+
+		// Request stages.
+		out	<< "# HELP udjat_http_stage_seconds_total Time spent on request stage." << endl
+			<< "# TYPE udjat_http_stage_seconds_total counter" << endl;
+		HTTP::Timing::for_each([&out](const HTTP::Timing::Stage stage, uint64_t, uint64_t total, uint64_t){
+			out << "udjat_http_stage_seconds_total{stage=\"" << HTTP::Timing::name(stage) << "\"} " << (((double) total) / 1000000.0) << endl;
+		});
+
+		out	<< "# HELP udjat_http_stage_requests_total Requests timed on stage." << endl
+			<< "# TYPE udjat_http_stage_requests_total counter" << endl;
+		HTTP::Timing::for_each([&out](const HTTP::Timing::Stage stage, uint64_t count, uint64_t, uint64_t){
+			out << "udjat_http_stage_requests_total{stage=\"" << HTTP::Timing::name(stage) << "\"} " << count << endl;
+		});
+
+		out	<< "# HELP udjat_http_stage_max_seconds Slowest request stage." << endl
+			<< "# TYPE udjat_http_stage_max_seconds gauge" << endl;
+		HTTP::Timing::for_each([&out](const HTTP::Timing::Stage stage, uint64_t, uint64_t, uint64_t max){
+			out << "udjat_http_stage_max_seconds{stage=\"" << HTTP::Timing::name(stage) << "\"} " << (((double) max) / 1000000.0) << endl;
+		});
+
+		return out.str();
+
+	}
+
+ }
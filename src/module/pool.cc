@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the request pool controller.
+  *
+  * Civetweb starts a fixed number of request threads, this is not a
+  * thread pool: with the concurrency limit enabled civetweb runs with
+  * 'concurrency-max' threads and the requests above the current limit
+  * wait (on their own civetweb thread) for a slot. The limit moves between
+  * 'concurrency-min' and 'concurrency-max' based on the queue depth.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/pool.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <algorithm>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	CivetWeb::Pool::Pool() {
+	}
+
+	CivetWeb::Pool & CivetWeb::Pool::getInstance() {
+		static Pool instance;
+		return instance;
+	}
+
+	void CivetWeb::Pool::setup(unsigned int threads) {
+
+		lock_guard<mutex> lock(guard);
+
+		limited = Config::Value<bool>("civetweb","concurrency-limit",false);
+		max = threads;
+		min = std::min((unsigned int) Config::Value<unsigned int>("civetweb","concurrency-min",4),max);
+		interval = milliseconds(Config::Value<unsigned int>("civetweb","concurrency-interval",1000));
+		limit = (limited ? min : max);
+		decision = steady_clock::now();
+
+		if(limited) {
+			Logger::String{"Concurrency limit enabled with ",min," to ",max," active handlers"}.info("civetweb");
+		}
+
+	}
+
+	CivetWeb::Pool::Thread & CivetWeb::Pool::thread() {
+
+		struct Registration {
+			Thread thread;
+
+			Registration() {
+				Pool &pool = Pool::getInstance();
+				lock_guard<mutex> lock(pool.guard);
+				thread.id = pool.ids++;
+				pool.threads.push_back(&thread);
+			}
+
+			~Registration() {
+				Pool &pool = Pool::getInstance();
+				lock_guard<mutex> lock(pool.guard);
+				pool.threads.remove(&thread);
+			}
+
+		};
+
+		static thread_local Registration registration;
+		return registration.thread;
+
+	}
+
+	void CivetWeb::Pool::adjust(const steady_clock::time_point &now) {
+
+		if(!limited || (now - decision) < interval) {
+			return;
+		}
+
+		decision = now;
+
+		if(waiting && limit < max) {
+
+			// Requests are queued, grow.
+			unsigned int from = limit;
+			limit = std::min(max,limit+std::max(waiting,1U));
+			counters.grow++;
+			Logger::String{"Active handlers ",from," -> ",limit," (",waiting," queued)"}.trace("civetweb");
+			cond.notify_all();
+
+		} else if(!waiting && (peak+1) < limit && limit > min) {
+
+			// Idle handlers, shrink.
+			unsigned int from = limit;
+			limit--;
+			counters.shrink++;
+			Logger::String{"Active handlers ",from," -> ",limit," (peak was ",peak,")"}.trace("civetweb");
+
+		}
+
+		peak = active;
+
+	}
+
+	bool CivetWeb::Pool::begin(unsigned int budget) noexcept {
+
+		Thread &current = thread();
+		auto now = steady_clock::now();
+
+		unique_lock<mutex> lock(guard);
+
+		counters.requests++;
+
+		if(limited && active >= limit) {
+
+			counters.queued++;
+			waiting++;
+			counters.max_waiting = std::max(counters.max_waiting,waiting);
+
+			auto deadline = (budget ? now + milliseconds(budget) : steady_clock::time_point::max());
+
+			while(active >= limit) {
+				adjust(steady_clock::now());
+				if(active < limit) {
+					break;
+				}
+				if(steady_clock::now() >= deadline) {
+					// Queue time budget exceeded.
+					waiting--;
+					counters.wait += duration_cast<microseconds>(steady_clock::now() - now).count();
+					counters.expired++;
+					return false;
+				}
+				cond.wait_for(lock,std::min(interval,duration_cast<milliseconds>(deadline - steady_clock::now())+milliseconds(1)));
+			}
+
+			waiting--;
+			counters.wait += duration_cast<microseconds>(steady_clock::now() - now).count();
+
+		}
+
+		active++;
+		peak = std::max(peak,active);
+		counters.max_active = std::max(counters.max_active,active);
+
+		adjust(now);
+
+		current.started = steady_clock::now();
+
+		return true;
+
+	}
+
+	void CivetWeb::Pool::end() noexcept {
+
+		Thread &current = thread();
+		auto now = steady_clock::now();
+
+		lock_guard<mutex> lock(guard);
+
+		current.requests++;
+		current.busy += duration_cast<microseconds>(now - current.started).count();
+
+		if(active) {
+			active--;
+		}
+
+		adjust(now);
+
+		if(limited) {
+			cond.notify_one();
+		}
+
+	}
+
+	void CivetWeb::Pool::get(Udjat::Value &value) {
+
+		lock_guard<mutex> lock(guard);
+
+		value["concurrency-limit"] = limited;
+		value["min"] = min;
+		value["max"] = max;
+		value["limit"] = limit;
+		value["active"] = active;
+		value["waiting"] = waiting;
+		value["requests"] = (double) counters.requests;
+		value["queued"] = (double) counters.queued;
+		value["wait-ms"] = (double) (counters.wait / 1000);
+		value["max-waiting"] = counters.max_waiting;
+		value["max-active"] = counters.max_active;
+		value["grow"] = (double) counters.grow;
+		value["shrink"] = (double) counters.shrink;
+		value["expired"] = (double) counters.expired;
+
+		Udjat::Value &list = value["threads"];
+		for(const Thread *thread : threads) {
+			Udjat::Value &item = list.append(Udjat::Value::Object);
+			item["id"] = thread->id;
+			item["requests"] = (double) thread->requests;
+			item["busy-ms"] = (double) (thread->busy / 1000);
+		}
+
+	}
+
+ }
@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the per-client rate limiter.
+  *
+  * Only routes listed in [http-rate-limits] are checked; the buckets are
+  * split in shards by key hash and the least recently used buckets are
+  * evicted when a shard is full.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/ratelimit.h>
+ #include <private/request.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/string.h>
+ #include <cstring>
+ #include <cmath>
+ #include <cstdio>
+ #include <algorithm>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	CivetWeb::RateLimiter::RateLimiter() {
+	}
+
+	CivetWeb::RateLimiter & CivetWeb::RateLimiter::getInstance() {
+		static RateLimiter instance;
+		return instance;
+	}
+
+	void CivetWeb::RateLimiter::setup() {
+
+		capacity = std::max((size_t) Config::Value<unsigned int>("http","rate-limit-clients",16384) / nshards,(size_t) 1);
+
+		// Format is path=rate[/burst], rate is in requests per second.
+		Config::for_each("http-rate-limits",[this](const char *path, const char *value){
+
+			double rate = 0, burst = 0;
+			if(sscanf(value,"%lf/%lf",&rate,&burst) < 1 || rate <= 0) {
+				Logger::String{"Invalid rate limit '",value,"' for '",path,"'"}.error("civetweb");
+				return true;
+			}
+
+			routes.emplace_back(path,rate,(burst >= 1 ? burst : std::max(rate,1.0)));
+			Logger::String{"Rate limit for '",path,"' is ",rate,"/s"}.trace("civetweb");
+
+			return true;
+		});
+
+		routes.sort([](const Route &a, const Route &b){
+			return a.path.size() > b.path.size();
+		});
+
+	}
+
+	int CivetWeb::RateLimiter::check(struct mg_connection *conn) noexcept {
+
+		if(routes.empty()) {
+			return 0;
+		}
+
+		const struct mg_request_info *info = mg_get_request_info(conn);
+
+		Route *route = nullptr;
+		for(Route &r : routes) {
+			// Whole path segments only, '/api' doesn't limit '/apix'.
+			size_t length = r.path.size();
+			const char *uri = info->local_uri;
+			if(length && !strncmp(uri,r.path.c_str(),length) && (!uri[length] || uri[length] == '/' || r.path[length-1] == '/')) {
+				route = &r;
+				break;
+			}
+		}
+
+		if(!route) {
+			return 0;
+		}
+
+		string key{Request::address(info).c_str()};
+		key += ' ';
+		key += route->path;
+
+		auto now = steady_clock::now();
+		double wait = 0;
+
+		{
+			Shard &shard = shards[std::hash<string>{}(key) % nshards];
+			lock_guard<mutex> lock(shard.guard);
+
+			auto it = shard.buckets.find(key);
+			if(it == shard.buckets.end()) {
+
+				if(shard.buckets.size() >= capacity) {
+					// Evict the idle bucket.
+					shard.buckets.erase(shard.lru.back());
+					shard.lru.pop_back();
+					counters.evicted++;
+				}
+
+				shard.lru.push_front(key);
+				Bucket &bucket = shard.buckets[key];
+				bucket.tokens = route->burst;
+				bucket.updated = now;
+				bucket.lru = shard.lru.begin();
+				it = shard.buckets.find(key);
+
+			} else {
+
+				shard.lru.splice(shard.lru.begin(),shard.lru,it->second.lru);
+
+			}
+
+			Bucket &bucket = it->second;
+
+			bucket.tokens = std::min(route->burst, bucket.tokens + (duration<double>(now - bucket.updated).count() * route->rate));
+			bucket.updated = now;
+
+			if(bucket.tokens >= 1) {
+				bucket.tokens -= 1;
+				return 0;
+			}
+
+			wait = (1 - bucket.tokens) / route->rate;
+
+		}
+
+		route->limited++;
+		counters.limited++;
+
+		mg_response_header_start(conn, 429);
+		mg_response_header_add(conn, "Retry-After", std::to_string((unsigned int) ceil(wait)).c_str(), -1);
+		mg_response_header_add(conn, "Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0", -1);
+		mg_response_header_add(conn, "Content-Length", "0", -1);
+		mg_response_header_send(conn);
+
+		return 429;
+
+	}
+
+	void CivetWeb::RateLimiter::get(Udjat::Value &value) {
+
+		size_t buckets = 0;
+		for(Shard &shard : shards) {
+			lock_guard<mutex> lock(shard.guard);
+			buckets += shard.buckets.size();
+		}
+
+		value["buckets"] = (unsigned int) buckets;
+		value["limited"] = (double) counters.limited;
+		value["evicted"] = (double) counters.evicted;
+
+		Udjat::Value &list = value["routes"];
+		for(const Route &route : routes) {
+			Udjat::Value &item = list.append(Udjat::Value::Object);
+			item["path"] = route.path.c_str();
+			item["rate"] = route.rate;
+			item["burst"] = route.burst;
+			item["limited"] = (double) route.limited;
+		}
+
+	}
+
+ }
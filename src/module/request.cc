@@ -31,6 +31,7 @@
  #include <udjat/tools/string.h>
  #include <udjat/tools/configuration.h>
  #include <udjat/tools/url.h>
+ #include <udjat/tools/http/timing.h>
  #include <ctype.h>
 
  #include <civetweb.h>
@@ -44,6 +45,8 @@
 		Request::Request(struct mg_connection *c)
 			: HTTP::Request{mg_get_request_info(c)->local_uri,mg_get_request_info(c)->request_method}, conn{c}, info{mg_get_request_info(c)} {
 
+			HTTP::Timing::Span span{HTTP::Timing::Parse};
+
 			debug("request_uri='",mg_get_request_info(c)->request_uri,"'");
 			debug("local_uri_raw='",mg_get_request_info(c)->local_uri_raw,"'");
 			debug("local_uri='",mg_get_request_info(c)->local_uri,"'");
@@ -107,6 +110,10 @@
 		}
 
 		String Request::address() const {
+			return address(info);
+		}
+
+		String Request::address(const struct mg_request_info *info) {
 
 			for(int header = 0; header < info->num_headers; header++) {
 				if(!strcasecmp(info->http_headers[header].name,"X-Forwarded-For")) {
@@ -18,12 +18,15 @@
  */
 
  #include <private/module.h>
+ #include <private/metrics.h>
+ #include <private/accesslog.h>
  #include <sys/types.h>
  #include <sys/stat.h>
  #include <udjat/version.h>
  #include <udjat/tools/http/timestamp.h>
  #include <udjat/tools/http/mimetype.h>
  #include <udjat/tools/http/connection.h>
+ #include <udjat/tools/http/timing.h>
  #include <udjat/tools/file.h>
  #include <udjat/tools/logger.h>
  #include <udjat/tools/configuration.h>
@@ -31,6 +34,7 @@
  #include <udjat/tools/intl.h>
  #include <udjat/tools/exception.h>
  #include <sstream>
+ #include <list>
  #include <fcntl.h>
 
  #ifdef HAVE_UNISTD_H
@@ -100,6 +104,7 @@
 			mg_response_header_send(conn);
 
 			if(method == HTTP::Get) {
+				CivetWeb::Metrics::sent(st.st_size);
 				mg_send_file_body(conn,filename.c_str());
 			}
 
@@ -191,6 +196,7 @@
 			mg_response_header_add(conn, "Content-Length", std::to_string(str.size()).c_str(), -1);
 			mg_response_header_send(conn);
 
+			CivetWeb::Metrics::sent(str.size());
 			mg_write(conn, str.c_str(), str.size());
 
 		} else {
@@ -207,6 +213,43 @@
 
  }
 
+ /// @brief Extra headers for the response of the current thread.
+ static thread_local std::list<std::pair<std::string,std::string>> extra_headers;
+
+ void add_response_header(const char *name, const char *value) {
+	extra_headers.emplace_back(name,value);
+ }
+
+ void clear_response_headers() noexcept {
+	extra_headers.clear();
+ }
+
+ static void send_extra_headers(struct mg_connection *conn) noexcept {
+	for(const auto &header : extra_headers) {
+		mg_response_header_add(conn, header.first.c_str(), header.second.c_str(), -1);
+	}
+ }
+
+ /// @brief Check if the Server-Timing header should be sent.
+ /// @return true if the client has asked for it (X-Server-Timing header) or the request was sampled.
+ static bool server_timing(struct mg_connection *conn) noexcept {
+
+	if(!HTTP::Timing::enabled()) {
+		return false;
+	}
+
+	const char *requested = mg_get_header(conn,"X-Server-Timing");
+	if(requested && *requested) {
+		return true;
+	}
+
+	static const unsigned int sample = Config::Value<unsigned int>("http","server-timing-sample",0);
+	static thread_local unsigned int requests = 0;
+
+	return sample && (++requests % sample) == 0;
+
+ }
+
  int send(struct mg_connection *conn, const Udjat::Abstract::Response &response) noexcept {
 
 	int code = HTTP::Exception::code(response.status_code());
@@ -217,8 +260,8 @@
 
 		debug("------------------------------------> NOT MODIFIED");
 
-		// Not modified
-		if(Logger::enabled(Logger::Trace)) {
+		// Not modified, when the access log is off trace it here.
+		if(!CivetWeb::AccessLog::getInstance().logged() && Logger::enabled(Logger::Trace)) {
 			Logger::String{
 				request_info->remote_addr," ",
 				request_info->request_method," ",
@@ -231,6 +274,7 @@
 			debug(header_name,"='",header_value,"'");
 			mg_response_header_add(conn, header_name, header_value, -1);
 		});
+		send_extra_headers(conn);
 		mg_response_header_send(conn);
 
 		return 304;
@@ -238,7 +282,13 @@
 
 	try {
 
-		string text{response.to_string()};
+		string text;
+		{
+			HTTP::Timing::Span span{HTTP::Timing::Serialize};
+			text = response.to_string();
+		}
+
+		HTTP::Timing::Span span{HTTP::Timing::Write};
 
 		// Build and send header
 		mg_response_header_start(conn, code);
@@ -260,6 +310,11 @@
 			debug(header_name,"='",header_value,"'");
 			mg_response_header_add(conn, header_name, header_value, -1);
 		});
+		send_extra_headers(conn);
+
+		if(server_timing(conn)) {
+			mg_response_header_add(conn, "Server-Timing", HTTP::Timing::to_string().c_str(), -1);
+		}
 
 		if(text.empty()) {
 
@@ -269,6 +324,7 @@
 
 			mg_response_header_add(conn, "Content-Length", std::to_string(text.size()).c_str(), -1);
 			mg_response_header_send(conn);
+			CivetWeb::Metrics::sent(text.size());
 			mg_write(conn, text.c_str(), text.size());
 
 		}
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the slow request journal.
+  *
+  * Only the requests timed by the root and custom handlers are checked;
+  * below the threshold the cost is the elapsed time clock read.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/slowlog.h>
+ #include <private/request.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/timestamp.h>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	CivetWeb::SlowLog::SlowLog() {
+	}
+
+	CivetWeb::SlowLog & CivetWeb::SlowLog::getInstance() {
+		static SlowLog instance;
+		return instance;
+	}
+
+	void CivetWeb::SlowLog::setup() {
+		lock_guard<mutex> lock(guard);
+		threshold = ((uint64_t) Config::Value<unsigned int>("slow-requests","threshold",1000)) * 1000;
+		size = Config::Value<unsigned int>("slow-requests","size",64);
+	}
+
+	void CivetWeb::SlowLog::push(const struct mg_connection *conn, int status, uint64_t bytes) noexcept {
+
+		if(!HTTP::Timing::enabled()) {
+			return;
+		}
+
+		uint64_t usec = HTTP::Timing::elapsed();
+		if(usec < threshold || !size) {
+			return;
+		}
+
+		count++;
+
+		try {
+
+			const struct mg_request_info *info = mg_get_request_info(conn);
+
+			Entry entry;
+			entry.when = time(0);
+			entry.method = info->request_method;
+			entry.uri = info->request_uri;
+			entry.client = Request::address(info).c_str();
+			entry.worker = HTTP::Timing::worker();
+			entry.status = status;
+			entry.bytes = bytes;
+			entry.usec = usec;
+
+			for(unsigned int stage = 0; stage < HTTP::Timing::StageCount; stage++) {
+				entry.stages[stage] = HTTP::Timing::get((HTTP::Timing::Stage) stage);
+			}
+
+			lock_guard<mutex> lock(guard);
+			entries.push_back(std::move(entry));
+			while(entries.size() > size) {
+				entries.pop_front();
+			}
+
+		} catch(...) {
+			// Ignore, the journal is not essential.
+		}
+
+	}
+
+	void CivetWeb::SlowLog::get(Udjat::Value &value) {
+
+		lock_guard<mutex> lock(guard);
+
+		value["threshold-ms"] = (unsigned int) (threshold / 1000);
+		value["count"] = (unsigned int) count;
+
+		Udjat::Value &list = value["requests"];
+
+		// Newest first.
+		for(auto it = entries.rbegin(); it != entries.rend(); it++) {
+
+			Udjat::Value &item = list.append(Udjat::Value::Object);
+
+			item["time"] = TimeStamp{it->when};
+			item["method"] = it->method.c_str();
+			item["uri"] = it->uri.c_str();
+			item["client"] = it->client.c_str();
+			item["worker"] = it->worker.c_str();
+			item["status"] = it->status;
+			item["bytes"] = (unsigned int) it->bytes;
+			item["ms"] = ((double) it->usec) / 1000.0;
+
+			Udjat::Value &stages = item["stages"];
+			for(unsigned int stage = 0; stage < HTTP::Timing::StageCount; stage++) {
+				stages[HTTP::Timing::name((HTTP::Timing::Stage) stage)] = ((double) it->stages[stage]) / 1000.0;
+			}
+
+		}
+
+	}
+
+ }
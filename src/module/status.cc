@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client allow-list for the status pages (metrics, pool and slow requests).
+  *
+  * The list ('civetweb/status-allow') has addresses or networks ('10.0.0.0/8',
+  * 'fd00::/8') separated by commas, '*' allows any client. The peer address
+  * is used, X-Forwarded-For is set by the client and can't be trusted here.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/module.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/string.h>
+ #include <cstring>
+ #include <cstdlib>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <arpa/inet.h>
+#endif // _WIN32
+
+ using namespace std;
+ using namespace Udjat;
+
+ namespace {
+
+	/// @brief Binary address, IPv4 mapped on IPv6 are stored as IPv4.
+	struct Address {
+		int family = 0;
+		unsigned char bytes[16];
+
+		bool set(const char *text) noexcept {
+
+			if(inet_pton(AF_INET,text,bytes) == 1) {
+				family = AF_INET;
+				return true;
+			}
+
+			if(inet_pton(AF_INET6,text,bytes) != 1) {
+				return false;
+			}
+
+			static const unsigned char mapped[12] = { 0,0,0,0,0,0,0,0,0,0,0xff,0xff };
+			if(!memcmp(bytes,mapped,sizeof(mapped))) {
+				memmove(bytes,bytes+12,4);
+				family = AF_INET;
+			} else {
+				family = AF_INET6;
+			}
+
+			return true;
+
+		}
+
+		inline unsigned int bits() const noexcept {
+			return family == AF_INET ? 32 : 128;
+		}
+
+		/// @brief Is this address in the network?
+		bool in(const Address &network, unsigned int prefix) const noexcept {
+
+			if(family != network.family) {
+				return false;
+			}
+
+			size_t bytes = prefix / 8;
+			if(memcmp(this->bytes,network.bytes,bytes)) {
+				return false;
+			}
+
+			unsigned int remainder = prefix % 8;
+			if(!remainder) {
+				return true;
+			}
+
+			unsigned char mask = (unsigned char) (0xff << (8 - remainder));
+			return (this->bytes[bytes] & mask) == (network.bytes[bytes] & mask);
+
+		}
+
+	};
+
+	bool matches(const Address &client, std::string item) {
+
+		item.erase(0,item.find_first_not_of(" \t"));
+		item.erase(item.find_last_not_of(" \t")+1);
+
+		if(item == "*") {
+			return true;
+		}
+
+		Address network;
+		unsigned int prefix = 0;
+
+		auto slash = item.find('/');
+		if(slash == string::npos) {
+
+			if(!network.set(item.c_str())) {
+				Logger::String{"Invalid address '",item.c_str(),"' on civetweb/status-allow"}.warning("civetweb");
+				return false;
+			}
+			prefix = network.bits();
+
+		} else {
+
+			char *end = nullptr;
+			prefix = (unsigned int) strtoul(item.c_str()+slash+1,&end,10);
+			bool valid = (end != item.c_str()+slash+1 && !*end);
+			item.resize(slash);
+
+			if(!(valid && network.set(item.c_str()) && prefix <= network.bits())) {
+				Logger::String{"Invalid network '",item.c_str(),"' on civetweb/status-allow"}.warning("civetweb");
+				return false;
+			}
+
+		}
+
+		return client.in(network,prefix);
+
+	}
+
+ }
+
+ bool status_allowed(struct mg_connection *conn) noexcept {
+
+	const char *remote = mg_get_request_info(conn)->remote_addr;
+
+	try {
+
+		Address client;
+		if(client.set(remote)) {
+
+			Config::Value<string> allow{"civetweb","status-allow","127.0.0.1,::1"};
+			for(const String &item : String{allow.c_str()}.split(",")) {
+				if(matches(client,item)) {
+					return true;
+				}
+			}
+
+		}
+
+	} catch(const std::exception &e) {
+
+		Logger::String{"Cant check civetweb/status-allow: ",e.what()}.error("civetweb");
+
+	}
+
+	Logger::String{remote,": Status page denied to ",mg_get_request_info(conn)->local_uri}.trace("civetweb");
+	return false;
+
+ }
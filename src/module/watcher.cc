@@ -0,0 +1,590 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the agent change watcher.
+  *
+  * The agent tree is scanned by a background thread; an agent has changed
+  * when its state level, value or summary differs from the last scan.
+  * Each change is serialized once and the frame is shared by every
+  * listener.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/watcher.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/agent/state.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/http/connection.h>
+ #include <udjat/worker.h>
+ #include <udjat/module.h>
+ #include <cstring>
+ #include <cstdio>
+ #include <cstdlib>
+ #include <cerrno>
+ #include <vector>
+ #include <set>
+ #include <algorithm>
+ #include <functional>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	CivetWeb::Watcher::Watcher() : epoch{(uint64_t) duration_cast<microseconds>(system_clock::now().time_since_epoch()).count()} {
+	}
+
+	CivetWeb::Watcher::~Watcher() {
+		stop();
+	}
+
+	CivetWeb::Watcher & CivetWeb::Watcher::getInstance() {
+		static Watcher instance;
+		return instance;
+	}
+
+	void CivetWeb::Watcher::start() {
+
+		lock_guard<mutex> lock(guard);
+
+		if(thread) {
+			return;
+		}
+
+		interval = milliseconds(std::max((unsigned int) Config::Value<unsigned int>("agent-updates","interval",1000),10U));
+		history_size = Config::Value<unsigned int>("agent-updates","history",1024);
+		running = true;
+
+		thread = new std::thread([this](){
+
+			Logger::String{"Watching agent changes every ",(unsigned int) interval.count(),"ms"}.trace("civetweb");
+
+			unique_lock<mutex> lock(guard);
+			while(running) {
+				lock.unlock();
+				try {
+					scan();
+				} catch(const std::exception &e) {
+					Logger::String{"Cant scan agents: ",e.what()}.error("civetweb");
+				}
+				lock.lock();
+				cond.wait_for(lock,interval);
+			}
+
+		});
+
+	}
+
+	void CivetWeb::Watcher::stop() {
+
+		std::thread *running_thread = nullptr;
+
+		{
+			lock_guard<mutex> lock(guard);
+			running = false;
+			running_thread = thread;
+			thread = nullptr;
+			cond.notify_all();
+			changed.notify_all();
+		}
+
+		if(running_thread) {
+			running_thread->join();
+			delete running_thread;
+		}
+
+	}
+
+	void CivetWeb::Watcher::escape(std::string &buffer, const char *str) {
+
+		buffer += '"';
+
+		for(const char *ptr = str; ptr && *ptr; ptr++) {
+			switch(*ptr) {
+			case '"':
+				buffer += "\\\"";
+				break;
+
+			case '\\':
+				buffer += "\\\\";
+				break;
+
+			case '\n':
+				buffer += "\\n";
+				break;
+
+			case '\r':
+				buffer += "\\r";
+				break;
+
+			case '\t':
+				buffer += "\\t";
+				break;
+
+			default:
+				if(((unsigned char) *ptr) < 0x20) {
+					char hex[8];
+					snprintf(hex,sizeof(hex),"\\u%04x",(unsigned int) *ptr);
+					buffer += hex;
+				} else {
+					buffer += *ptr;
+				}
+			}
+		}
+
+		buffer += '"';
+
+	}
+
+	bool CivetWeb::Watcher::match(const char *prefix, const std::string &path) noexcept {
+
+		if(!prefix || !*prefix || !strcmp(prefix,"/")) {
+			return true;
+		}
+
+		size_t length = strlen(prefix);
+		if(prefix[length-1] == '/') {
+			length--;
+		}
+
+		return strncmp(path.c_str(),prefix,length) == 0 && (path.size() == length || path[length] == '/');
+
+	}
+
+	std::shared_ptr<const std::string> CivetWeb::Watcher::serialize(const Agent &agent) {
+
+		auto frame = make_shared<std::string>();
+
+		*frame += "{\"version\":";
+		*frame += std::to_string(agent.version);
+		*frame += ",\"path\":";
+		escape(*frame,agent.path.c_str());
+
+		if(agent.seen) {
+			*frame += ",\"name\":";
+			escape(*frame,agent.name.c_str());
+			*frame += ",\"level\":";
+			escape(*frame,agent.level.c_str());
+			*frame += ",\"value\":";
+			escape(*frame,agent.value.c_str());
+			*frame += ",\"summary\":";
+			escape(*frame,agent.summary.c_str());
+		} else {
+			*frame += ",\"removed\":true";
+		}
+
+		*frame += "}";
+
+		return frame;
+
+	}
+
+	void CivetWeb::Watcher::scan() {
+
+		// The index page lists the workers and the information module, check them too.
+		{
+			size_t fingerprint = (Udjat::Module::find("information") ? 1 : 0);
+			Worker::for_each([&fingerprint](const Worker &worker){
+				fingerprint = (fingerprint * 31) + std::hash<std::string>{}(worker.c_str());
+				return false;
+			});
+
+			if(fingerprint != workers) {
+				workers = fingerprint;
+				HTTP::Connection::invalidate();
+			}
+		}
+
+		// Read the tree without the lock.
+		std::vector<Agent> current;
+
+		auto root = Abstract::Agent::root();
+		if(root) {
+			root->for_each([&current](Abstract::Agent &agent){
+				current.emplace_back();
+				Agent &item = current.back();
+				item.name = agent.name();
+				item.path = agent.path();
+				item.level = std::to_string(agent.state()->level());
+				item.value = agent.Abstract::Object::getProperty("value","");
+				const char *summary = agent.summary();
+				item.summary = (summary ? summary : "");
+				item.seen = true;
+			});
+		}
+
+		std::vector<Change> changes;
+		std::vector<Listener> targets;
+
+		// Changes on the fields of the index page (the agent value isn't there).
+		bool rendered = false;
+
+		lock_guard<mutex> notifying(notify);
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			for(auto &it : agents) {
+				it.second.seen = false;
+			}
+
+			for(Agent &agent : current) {
+
+				auto it = agents.find(agent.path);
+
+				if(it != agents.end()
+					&& it->second.level == agent.level
+					&& it->second.value == agent.value
+					&& it->second.summary == agent.summary
+					&& it->second.name == agent.name) {
+
+					it->second.seen = true;
+					continue;
+				}
+
+				if(it == agents.end()
+					|| it->second.level != agent.level
+					|| it->second.summary != agent.summary
+					|| it->second.name != agent.name) {
+					rendered = true;
+				}
+
+				agent.version = ++version;
+				agent.frame = serialize(agent);
+
+				Change change;
+				change.version = agent.version;
+				change.path = agent.path;
+				change.frame = agent.frame;
+				changes.push_back(change);
+
+				agents[agent.path] = std::move(agent);
+
+			}
+
+			// Removed agents.
+			for(auto it = agents.begin(); it != agents.end();) {
+
+				if(it->second.seen) {
+					it++;
+					continue;
+				}
+
+				it->second.version = ++version;
+				rendered = true;
+
+				Change change;
+				change.version = it->second.version;
+				change.path = it->second.path;
+				change.frame = serialize(it->second);
+				changes.push_back(change);
+
+				it = agents.erase(it);
+
+			}
+
+			if(changes.empty() && document) {
+				return;
+			}
+
+			if(rendered) {
+				HTTP::Connection::invalidate();
+			}
+
+			for(const Change &change : changes) {
+				history.push_back(change);
+			}
+
+			while(history.size() > history_size) {
+				history.pop_front();
+			}
+
+			// Rebuild the snapshot from the agent frames, only the changed ones were serialized.
+			{
+				size_t length = 64;
+				for(auto &it : agents) {
+					length += it.second.frame->size() + 1;
+				}
+
+				auto text = make_shared<std::string>();
+				text->reserve(length);
+
+				*text += "{\"version\":\"";
+				*text += token(version);
+				*text += "\",\"agents\":[";
+				bool first = true;
+				for(auto &it : agents) {
+					if(!first) {
+						*text += ',';
+					}
+					first = false;
+					*text += *it.second.frame;
+				}
+				*text += "]}";
+
+				document = text;
+			}
+
+			changed.notify_all();
+
+			for(auto &it : listeners) {
+				targets.push_back(it.second);
+			}
+
+		}
+
+		for(const Change &change : changes) {
+			for(Listener &listener : targets) {
+				listener(change);
+			}
+		}
+
+	}
+
+	unsigned int CivetWeb::Watcher::subscribe(const Listener &listener) {
+
+		unsigned int id;
+
+		{
+			lock_guard<mutex> lock(guard);
+			id = ++last_id;
+			listeners[id] = listener;
+		}
+
+		start();
+
+		return id;
+
+	}
+
+	void CivetWeb::Watcher::unsubscribe(unsigned int id) {
+		lock_guard<mutex> notifying(notify);
+		lock_guard<mutex> lock(guard);
+		listeners.erase(id);
+	}
+
+	const char * CivetWeb::Watcher::path(const char *uri) noexcept {
+
+		if(strncmp(uri,"/api/",5)) {
+			return nullptr;
+		}
+
+		// Skip version.
+		const char *ptr = strchr(uri+5,'/');
+		if(!ptr) {
+			return nullptr;
+		}
+
+		// '/agent', '/agent/<path>' or '/agent.<extension>'.
+		if(strncmp(ptr,"/agent",6) || (ptr[6] && ptr[6] != '/' && ptr[6] != '.')) {
+			return nullptr;
+		}
+
+		return ptr+6;
+
+	}
+
+	std::string CivetWeb::Watcher::prefix(const char *path) {
+
+		std::string prefix{path};
+
+		auto slash = prefix.rfind('/');
+		auto dot = prefix.rfind('.');
+		if(dot != string::npos && (slash == string::npos || dot > slash)) {
+			prefix.resize(dot);
+		}
+
+		return prefix;
+
+	}
+
+	uint64_t CivetWeb::Watcher::last() {
+		start();
+		lock_guard<mutex> lock(guard);
+		return version;
+	}
+
+	std::string CivetWeb::Watcher::token(uint64_t version) const {
+		std::string token{std::to_string(epoch)};
+		token += '-';
+		token += std::to_string(version);
+		return token;
+	}
+
+	bool CivetWeb::Watcher::parse(const char *token, uint64_t &version) const noexcept {
+
+		if(!(token && *token)) {
+			return false;
+		}
+
+		char *ptr = nullptr;
+		errno = 0;
+		uint64_t value = strtoull(token,&ptr,10);
+		if(errno || value != epoch || !ptr || *ptr != '-') {
+			return false;
+		}
+
+		token = ptr+1;
+		version = strtoull(token,&ptr,10);
+		return !errno && ptr != token && !*ptr;
+
+	}
+
+	bool CivetWeb::Watcher::replay(uint64_t since, const char *prefix, const std::function<void(const Change &change)> &call) {
+
+		lock_guard<mutex> lock(guard);
+
+		if(since > version) {
+			// Not from this watcher.
+			return false;
+		}
+
+		if(since == version) {
+			return true;
+		}
+
+		if(history.empty() || history.front().version > since+1) {
+			return false;
+		}
+
+		for(const Change &change : history) {
+			if(change.version > since && match(prefix,change.path)) {
+				call(change);
+			}
+		}
+
+		return true;
+
+	}
+
+	uint64_t CivetWeb::Watcher::wait(const char *prefix, uint64_t since, const std::chrono::milliseconds &timeout) {
+
+		start();
+
+		auto deadline = steady_clock::now() + timeout;
+
+		unique_lock<mutex> lock(guard);
+
+		while(running) {
+
+			if(since > version) {
+				// Not from this watcher.
+				break;
+			}
+
+			if(since < version) {
+
+				// Changes after 'since' aren't on the history, assume the prefix has changed.
+				if(history.empty() || history.front().version > since+1) {
+					break;
+				}
+
+				for(auto it = history.rbegin(); it != history.rend() && it->version > since; it++) {
+					if(match(prefix,it->path)) {
+						return version;
+					}
+				}
+
+				// Nothing under prefix, wait for the next ones.
+				since = version;
+
+			}
+
+			if(changed.wait_until(lock,deadline) == std::cv_status::timeout) {
+				break;
+			}
+
+		}
+
+		return version;
+
+	}
+
+	uint64_t CivetWeb::Watcher::delta(uint64_t since, const char *prefix, bool &full, const std::function<void(const std::string &frame)> &call) {
+
+		start();
+
+		unique_lock<mutex> lock(guard);
+
+		if(!document) {
+			// Wait for the first scan, an empty list would be a false answer.
+			changed.wait_for(lock,interval*2);
+		}
+
+		// A version ahead of the current one is from another start of the service.
+		full = (since > version || (since < version && (history.empty() || history.front().version > since+1)));
+
+		if(full) {
+
+			// Changes after 'since' aren't on the history, send all agents.
+			for(auto &it : agents) {
+				if(match(prefix,it.first)) {
+					call(*it.second.frame);
+				}
+			}
+
+		} else {
+
+			// Newest first, only the last change of each agent.
+			std::set<std::string> sent;
+			for(auto it = history.rbegin(); it != history.rend() && it->version > since; it++) {
+				if(match(prefix,it->path) && sent.insert(it->path).second) {
+					call(*it->frame);
+				}
+			}
+
+		}
+
+		return version;
+
+	}
+
+	std::shared_ptr<const std::string> CivetWeb::Watcher::snapshot(uint64_t &version) {
+
+		start();
+
+		unique_lock<mutex> lock(guard);
+
+		if(!document) {
+			// Wait for the first scan.
+			changed.wait_for(lock,interval*2);
+		}
+
+		version = this->version;
+		return document;
+
+	}
+
+	void CivetWeb::Watcher::for_each(const char *prefix, const std::function<void(const Agent &agent)> &call) {
+
+		lock_guard<mutex> lock(guard);
+
+		for(auto &it : agents) {
+			if(match(prefix,it.first)) {
+				call(it.second);
+			}
+		}
+
+	}
+
+ }
@@ -0,0 +1,360 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the HTTP/1.1 request and response exchange.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/client.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/configuration.h>
+ #include <system_error>
+ #include <stdexcept>
+ #include <cstring>
+ #include <cstdlib>
+ #include <cctype>
+ #include <cerrno>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	CivetWeb::Client::Client(const char *scheme, const char *hostname, unsigned int port, const std::string &request, bool head) : empty{head} {
+
+		auto &pool = SessionPool::getInstance();
+
+		// Only idempotent requests are sent again.
+		bool retry = (head || strncmp(request.c_str(),"GET ",4) == 0);
+
+		bool reused = false;
+		session = pool.get(scheme,hostname,port,reused);
+
+		try {
+
+			exchange(request);
+
+		} catch(const std::exception &e) {
+
+			// Only once, when the server has closed the idle session before answering.
+			if(!(reused && retry && closed)) {
+				throw;
+			}
+
+			Logger::String{session->key,": ",e.what()," on reused session, retrying"}.trace("civetweb");
+			session = pool.get(scheme,hostname,port,reused);
+			exchange(request);
+
+		}
+
+	}
+
+	CivetWeb::Client::~Client() {
+		if(session && keepalive && complete) {
+			SessionPool::getInstance().put(std::move(session));
+		}
+	}
+
+	void CivetWeb::Client::exchange(const std::string &request) {
+
+		timing = session->timing;
+		timing.reused = (session->requests > 0);
+		if(timing.reused) {
+			timing.dns = timing.connect = timing.tls = std::chrono::microseconds{0};
+		}
+
+		auto sent = std::chrono::steady_clock::now();
+
+		session->requests++;
+		closed = false;
+
+		string line;
+		bool http10 = false;
+
+		try {
+
+			session->write(request.c_str(),request.size());
+
+			// The server closes an idle session with EOF or a reset.
+			if(!session->getline(line)) {
+				throw system_error(ECONNRESET,system_category(),"Connection closed by server");
+			}
+
+		} catch(const system_error &e) {
+
+			if(e.code().value() == ECONNRESET || e.code().value() == EPIPE) {
+				closed = line.empty();
+			}
+			throw;
+
+		}
+
+		// Skip interim responses (100 Continue).
+		for(bool first = true;; first = false) {
+
+			if(!first && !session->getline(line)) {
+				throw system_error(ECONNRESET,system_category(),"Connection closed by server");
+			}
+
+			if(timing.ttfb.count() == 0) {
+				timing.ttfb = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent);
+			}
+
+			if(strncmp(line.c_str(),"HTTP/1.",7) || line.size() < 12) {
+				throw runtime_error("Invalid server response");
+			}
+
+			http10 = (line[7] == '0');
+			status = atoi(line.c_str()+9);
+			text = (line.size() > 13 ? line.substr(13) : "");
+
+			headers.clear();
+			while(session->getline(line) && !line.empty()) {
+
+				auto colon = line.find(':');
+				if(colon == string::npos) {
+					continue;
+				}
+
+				auto from = line.find_first_not_of(" \t",colon+1);
+				headers.emplace_back(line.substr(0,colon),(from == string::npos ? "" : line.substr(from)));
+
+			}
+
+			if(status < 100 || status >= 200) {
+				break;
+			}
+
+		}
+
+		keepalive = !http10;
+
+		const char *connection = header("Connection");
+		if(connection) {
+			if(!strcasecmp(connection,"close")) {
+				keepalive = false;
+			} else if(!strcasecmp(connection,"keep-alive")) {
+				keepalive = true;
+			}
+		}
+
+		const char *value = header("Content-Length");
+		if(value) {
+			length = atoll(value);
+		}
+		wire.length = length;
+
+		if(empty || status == 204 || status == 304) {
+
+			empty = true;
+			complete = true;
+
+		} else if((value = header("Transfer-Encoding")) != nullptr && strstr(value,"chunked")) {
+
+			chunked = true;
+			remaining = 0;
+
+		} else if(length >= 0) {
+
+			remaining = length;
+			complete = (length == 0);
+
+		} else {
+
+			// Body ends when the server closes the connection.
+			remaining = -1;
+			keepalive = false;
+
+		}
+
+	}
+
+	const char * CivetWeb::Client::header(const char *name) const noexcept {
+		for(const auto &header : headers) {
+			if(!strcasecmp(header.first.c_str(),name)) {
+				return header.second.c_str();
+			}
+		}
+		return nullptr;
+	}
+
+	void CivetWeb::Client::decode(const char *encoding) {
+
+		if(complete) {
+			// No body.
+			return;
+		}
+
+		decoder = Decoder::factory(encoding);
+		if(decoder) {
+			// The content length is the encoded one.
+			length = -1;
+			encoded.resize(16384);
+			limit = Config::Value<unsigned int>("http-client","max-decoded",268435456);
+		}
+
+	}
+
+	size_t CivetWeb::Client::read(void *data, size_t length) {
+
+		if(!decoder) {
+			return receive(data,length);
+		}
+
+		if(!length) {
+			return 0;
+		}
+
+		for(;;) {
+
+			if(position < available) {
+
+				const char *input = encoded.data() + position;
+				size_t pending = available - position;
+
+				size_t bytes = decoder->decode(input,pending,(char *) data,length);
+				position = available - pending;
+
+				if(bytes) {
+					decoded += bytes;
+					if(limit && decoded > limit) {
+						// Compression bomb or just too large, the session can't be reused.
+						throw system_error(E2BIG,system_category(),Logger::String{"Decoded response is larger than ",limit," bytes"});
+					}
+					return bytes;
+				}
+
+			}
+
+			if(decoder->finished()) {
+
+				// Drain the body, the session can be reused.
+				while(receive(encoded.data(),encoded.size()));
+				position = available = 0;
+				return 0;
+
+			}
+
+			// Keep what the decoder hasn't consumed.
+			if(position) {
+				memmove(encoded.data(),encoded.data()+position,available-position);
+				available -= position;
+				position = 0;
+			}
+
+			size_t bytes = receive(encoded.data()+available,encoded.size()-available);
+			if(!bytes) {
+				throw system_error(ECONNRESET,system_category(),"Compressed response is incomplete");
+			}
+			available += bytes;
+
+		}
+
+	}
+
+	long long CivetWeb::Client::chunksize(const char *line) {
+
+		if(!isxdigit(*line)) {
+			throw system_error(EBADMSG,system_category(),"Invalid chunk size");
+		}
+
+		char *end = nullptr;
+		errno = 0;
+		long long size = strtoll(line,&end,16);
+
+		while(*end == ' ' || *end == '\t') {
+			end++;
+		}
+
+		if(errno || size < 0 || (*end && *end != ';' && *end != '\r')) {
+			throw system_error(EBADMSG,system_category(),"Invalid chunk size");
+		}
+
+		return size;
+
+	}
+
+	size_t CivetWeb::Client::receive(void *data, size_t length) {
+
+		if(complete || !length) {
+			return 0;
+		}
+
+		if(chunked && !remaining) {
+
+			string line;
+			if(!session->getline(line)) {
+				throw system_error(ECONNRESET,system_category(),"Connection closed while reading chunk");
+			}
+
+			remaining = chunksize(line.c_str());
+
+			if(remaining <= 0) {
+
+				// Last chunk, skip trailers.
+				while(session->getline(line) && !line.empty());
+				remaining = 0;
+				complete = true;
+				return 0;
+
+			}
+
+		}
+
+		if(remaining > 0 && ((long long) length) > remaining) {
+			length = (size_t) remaining;
+		}
+
+		size_t bytes = session->read(data,length);
+
+		if(!bytes) {
+
+			if(remaining < 0) {
+				complete = true;
+				return 0;
+			}
+
+			throw system_error(ECONNRESET,system_category(),"Connection closed while reading response");
+
+		}
+
+		wire.received += bytes;
+
+		if(remaining > 0) {
+
+			remaining -= bytes;
+
+			if(!remaining) {
+				if(chunked) {
+					// Chunk data ends with CRLF.
+					string crlf;
+					session->getline(crlf);
+				} else {
+					complete = true;
+				}
+			}
+
+		}
+
+		return bytes;
+
+	}
+
+ }
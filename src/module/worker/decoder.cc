@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client content decoders (zlib and zstd).
+  *
+  * 'deflate' should be zlib wrapped but some servers send raw deflate,
+  * the first block decides.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/decoder.h>
+ #include <udjat/tools/logger.h>
+ #include <system_error>
+ #include <stdexcept>
+ #include <cstring>
+ #include <cerrno>
+
+#ifdef HAVE_ZLIB
+	#include <zlib.h>
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+	#include <zstd.h>
+#endif // HAVE_ZSTD
+
+ using namespace std;
+
+ namespace Udjat {
+
+#ifdef HAVE_ZLIB
+	class UDJAT_PRIVATE ZLibDecoder : public CivetWeb::Decoder {
+	private:
+		z_stream stream;
+		bool deflate;
+		bool started = false;
+		bool end = false;
+
+		void init(int bits) {
+			memset(&stream,0,sizeof(stream));
+			if(inflateInit2(&stream,bits) != Z_OK) {
+				throw runtime_error("Cant initialize zlib");
+			}
+		}
+
+	public:
+		ZLibDecoder(bool d) : deflate{d} {
+			// 15+32 detects gzip or zlib headers.
+			init(deflate ? 15 : 15+32);
+		}
+
+		~ZLibDecoder() override {
+			inflateEnd(&stream);
+		}
+
+		size_t decode(const char * &input, size_t &available, char *output, size_t length) override {
+
+			if(end || !available || (deflate && !started && available < 2)) {
+				// The zlib header check needs both bytes.
+				return 0;
+			}
+
+			stream.next_in = (Bytef *) input;
+			stream.avail_in = (uInt) available;
+			stream.next_out = (Bytef *) output;
+			stream.avail_out = (uInt) length;
+
+			int rc = inflate(&stream,Z_NO_FLUSH);
+
+			if(rc == Z_DATA_ERROR && deflate && !started) {
+
+				// Raw deflate, without the zlib header.
+				inflateEnd(&stream);
+				init(-15);
+
+				stream.next_in = (Bytef *) input;
+				stream.avail_in = (uInt) available;
+				stream.next_out = (Bytef *) output;
+				stream.avail_out = (uInt) length;
+
+				rc = inflate(&stream,Z_NO_FLUSH);
+
+			}
+
+			if(stream.total_in >= 2) {
+				// The header was checked.
+				started = true;
+			}
+
+			if(rc == Z_STREAM_END) {
+				end = true;
+			} else if(rc != Z_OK && rc != Z_BUF_ERROR) {
+				throw runtime_error(Logger::String{"Cant decode response: ",(stream.msg ? stream.msg : "zlib error")});
+			}
+
+			size_t consumed = available - stream.avail_in;
+			input += consumed;
+			available -= consumed;
+
+			return length - stream.avail_out;
+
+		}
+
+		bool finished() const noexcept override {
+			return end;
+		}
+
+	};
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+	class UDJAT_PRIVATE ZStdDecoder : public CivetWeb::Decoder {
+	private:
+		ZSTD_DStream *stream;
+		bool end = false;
+
+	public:
+		ZStdDecoder() : stream{ZSTD_createDStream()} {
+			if(!stream) {
+				throw runtime_error("Cant initialize zstd");
+			}
+			ZSTD_initDStream(stream);
+		}
+
+		~ZStdDecoder() override {
+			ZSTD_freeDStream(stream);
+		}
+
+		size_t decode(const char * &input, size_t &available, char *output, size_t length) override {
+
+			if(end || !available) {
+				return 0;
+			}
+
+			ZSTD_inBuffer in{input,available,0};
+			ZSTD_outBuffer out{output,length,0};
+
+			size_t rc = ZSTD_decompressStream(stream,&out,&in);
+			if(ZSTD_isError(rc)) {
+				throw runtime_error(Logger::String{"Cant decode response: ",ZSTD_getErrorName(rc)});
+			}
+
+			if(rc == 0) {
+				end = true;
+			}
+
+			input += in.pos;
+			available -= in.pos;
+
+			return out.pos;
+
+		}
+
+		bool finished() const noexcept override {
+			return end;
+		}
+
+	};
+#endif // HAVE_ZSTD
+
+	CivetWeb::Decoder::~Decoder() {
+	}
+
+	const char * CivetWeb::Decoder::accepted() noexcept {
+#if defined(HAVE_ZLIB) && defined(HAVE_ZSTD)
+		return "gzip, deflate, zstd";
+#elif defined(HAVE_ZLIB)
+		return "gzip, deflate";
+#elif defined(HAVE_ZSTD)
+		return "zstd";
+#else
+		return "";
+#endif
+	}
+
+	std::unique_ptr<CivetWeb::Decoder> CivetWeb::Decoder::factory(const char *encoding) {
+
+		if(!(encoding && *encoding) || !strcasecmp(encoding,"identity")) {
+			return std::unique_ptr<Decoder>();
+		}
+
+#ifdef HAVE_ZLIB
+		if(!strcasecmp(encoding,"gzip") || !strcasecmp(encoding,"x-gzip")) {
+			return std::unique_ptr<Decoder>(new ZLibDecoder(false));
+		}
+
+		if(!strcasecmp(encoding,"deflate")) {
+			return std::unique_ptr<Decoder>(new ZLibDecoder(true));
+		}
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTD
+		if(!strcasecmp(encoding,"zstd")) {
+			return std::unique_ptr<Decoder>(new ZStdDecoder());
+		}
+#endif // HAVE_ZSTD
+
+		throw system_error(ENOTSUP,system_category(),Logger::String{"Unsupported content encoding '",encoding,"'"});
+
+	}
+
+ }
@@ -0,0 +1,1018 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the multiplexed client engine.
+  *
+  * Each request is a state machine (connect, TLS handshake, send, headers,
+  * body) driven by one epoll thread; the caller resolves the server name
+  * and builds the request, the engine thread never blocks. Results are
+  * delivered on the main loop, or from the engine thread for batches.
+  * When connect fails the next address of the server is tried.
+  *
+  * The engine connections aren't pooled, the requests are sent with
+  * 'Connection: close'.
+  *
+  * On windows each request runs on its own thread with the blocking client.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/engine.h>
+ #include <private/module.h>
+ #include <private/client.h>
+ #include <private/resolver.h>
+ #include <private/tlscache.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/mainloop.h>
+ #include <condition_variable>
+ #include <algorithm>
+ #include <system_error>
+ #include <cstring>
+ #include <cerrno>
+
+#ifndef _WIN32
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif // !_WIN32
+
+#ifdef HAVE_LIBSSL
+	#include <openssl/err.h>
+#endif // HAVE_LIBSSL
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	struct CivetWeb::Engine::Request {
+
+		Result result;
+		Callback callback;
+
+		/// @brief Call the callback from the engine thread.
+		bool direct = false;
+
+		std::string scheme;
+		std::string hostname;
+		unsigned int port = 80;
+
+		/// @brief Server key for the TLS session cache.
+		std::string key;
+		bool head = false;
+
+		steady_clock::time_point started;
+		steady_clock::time_point deadline;
+
+		/// @brief The request text.
+		std::string output;
+		size_t sent = 0;
+
+		/// @brief Received, not parsed.
+		std::string input;
+		size_t position = 0;
+
+#ifndef _WIN32
+		/// @brief Server addresses, the next one is tried when connect fails.
+		Resolver::Addresses addresses;
+		size_t current = 0;
+
+		int fd = -1;
+
+		/// @brief The socket was added to epoll.
+		bool registered = false;
+
+#ifdef HAVE_LIBSSL
+		SSL *ssl = nullptr;
+#endif // HAVE_LIBSSL
+
+		enum State {
+			Connecting,
+			Handshake,
+			Sending,
+			Headers,
+			Body,
+			Done
+		} state = Connecting;
+
+		/// @brief Content length (-1 until close).
+		long long length = -1;
+
+		/// @brief Chunked body.
+		bool chunked = false;
+		long long chunk = 0;
+		bool last = false;
+
+		void close() noexcept {
+#ifdef HAVE_LIBSSL
+			if(ssl) {
+				SSL_free(ssl);
+				ssl = nullptr;
+			}
+#endif // HAVE_LIBSSL
+			if(fd >= 0) {
+				::close(fd);
+				fd = -1;
+			}
+			registered = false;
+		}
+
+		~Request() {
+			close();
+		}
+#endif // !_WIN32
+
+	};
+
+	CivetWeb::Engine::Engine() {
+	}
+
+	CivetWeb::Engine::~Engine() {
+		stop();
+	}
+
+	CivetWeb::Engine & CivetWeb::Engine::getInstance() {
+		static Engine instance;
+		return instance;
+	}
+
+	std::shared_ptr<CivetWeb::Engine::Request> CivetWeb::Engine::prepare(Worker &worker, const Callback &callback, const std::chrono::milliseconds &timeout) {
+
+		auto request = make_shared<Request>();
+
+		request->callback = callback;
+		request->result.url = worker.url().c_str();
+		request->started = steady_clock::now();
+		request->deadline = request->started + (timeout.count() ? timeout : milliseconds(Config::Value<time_t>("http","timeout",10) * 1000));
+
+		URL::Components components = worker.url().ComponentsFactory();
+		request->scheme = components.scheme;
+		request->hostname = components.hostname;
+		request->port = components.portnumber();
+		request->head = (strcasecmp(std::to_string(worker.method()),"HEAD") == 0);
+
+		// The connection is closed after the response, restore the worker header after building.
+		const char *connection = worker.requested("Connection");
+		std::string previous{connection ? connection : ""};
+		worker.request("Connection") = "close";
+
+		auto restore = [&worker,&previous](){
+			if(previous.empty()) {
+				worker.unset("Connection");
+			} else {
+				worker.request("Connection") = previous;
+			}
+		};
+
+		try {
+			request->output = worker.build(components);
+		} catch(...) {
+			restore();
+			throw;
+		}
+
+		restore();
+
+		return request;
+
+	}
+
+	void CivetWeb::Engine::push(Worker &worker, const Callback &callback, const std::chrono::milliseconds &timeout) {
+		push(prepare(worker,callback,timeout));
+	}
+
+	std::vector<CivetWeb::Engine::Result> CivetWeb::Engine::get(const std::vector<std::string> &urls, const std::chrono::milliseconds &timeout) {
+
+		struct {
+			std::mutex guard;
+			std::condition_variable cond;
+			size_t pending = 0;
+		} batch;
+
+		std::vector<Result> results{urls.size()};
+
+		batch.pending = urls.size();
+
+		for(size_t ix = 0; ix < urls.size(); ix++) {
+
+			std::shared_ptr<Request> request;
+
+			try {
+
+				Worker worker{urls[ix].c_str()};
+				request = prepare(worker,[&batch,&results,ix](const Result &result){
+					lock_guard<mutex> lock(batch.guard);
+					results[ix] = result;
+					batch.pending--;
+					batch.cond.notify_all();
+				},timeout);
+
+			} catch(const std::exception &e) {
+
+				lock_guard<mutex> lock(batch.guard);
+				results[ix].url = urls[ix];
+				results[ix].error = EINVAL;
+				results[ix].message = e.what();
+				batch.pending--;
+				continue;
+
+			}
+
+			request->direct = true;
+			push(request);
+
+		}
+
+		unique_lock<mutex> lock(batch.guard);
+		batch.cond.wait(lock,[&batch](){ return batch.pending == 0; });
+
+		return results;
+
+	}
+
+	void CivetWeb::Engine::finish(std::shared_ptr<Request> request) noexcept {
+
+#ifndef _WIN32
+		request->close();
+		request->state = Request::Done;
+#endif // !_WIN32
+
+		request->result.elapsed = duration_cast<milliseconds>(steady_clock::now() - request->started);
+
+		counters.active--;
+		if(request->result.status) {
+			counters.completed++;
+		} else {
+			counters.failed++;
+			if(request->result.error == ETIMEDOUT) {
+				counters.timeouts++;
+			}
+		}
+
+		try {
+
+			if(request->direct) {
+
+				request->callback(request->result);
+
+			} else {
+
+				auto callback = request->callback;
+				auto result = request->result;
+				MainLoop::getInstance().post([callback,result](){
+					callback(result);
+				});
+
+			}
+
+		} catch(const std::exception &e) {
+
+			Logger::String{request->result.url,": ",e.what()}.error("civetweb");
+
+		}
+
+	}
+
+	void CivetWeb::Engine::get(Udjat::Value &value) {
+		value["started"] = (double) counters.started;
+		value["completed"] = (double) counters.completed;
+		value["failed"] = (double) counters.failed;
+		value["timeouts"] = (double) counters.timeouts;
+		value["active"] = (unsigned int) counters.active;
+	}
+
+#ifdef _WIN32
+
+	void CivetWeb::Engine::start() {
+	}
+
+	void CivetWeb::Engine::stop() {
+	}
+
+	void CivetWeb::Engine::run() {
+	}
+
+	void CivetWeb::Engine::push(std::shared_ptr<Request> request) {
+
+		counters.started++;
+		counters.active++;
+
+		std::thread{[this,request](){
+
+			try {
+
+				Client client{request->scheme.c_str(),request->hostname.c_str(),request->port,request->output,request->head};
+
+				char buffer[16384];
+				size_t bytes;
+				while((bytes = client.read(buffer,sizeof(buffer))) > 0) {
+					request->result.body.append(buffer,bytes);
+				}
+
+				request->result.status = client.status;
+				request->result.text = client.text;
+
+			} catch(const std::system_error &e) {
+
+				request->result.error = e.code().value();
+				request->result.message = e.what();
+
+			} catch(const std::exception &e) {
+
+				request->result.error = EIO;
+				request->result.message = e.what();
+
+			}
+
+			finish(request);
+
+		}}.detach();
+
+	}
+
+#else
+
+	/// @brief I/O result when the socket isn't ready.
+	static const ssize_t WantRead = -1;
+	static const ssize_t WantWrite = -2;
+
+#ifdef HAVE_LIBSSL
+	static ssize_t ssl_result(SSL *ssl, int rc, const std::string &hostname) {
+
+		switch(SSL_get_error(ssl,rc)) {
+		case SSL_ERROR_WANT_READ:
+			return WantRead;
+
+		case SSL_ERROR_WANT_WRITE:
+			return WantWrite;
+
+		case SSL_ERROR_ZERO_RETURN:
+			return 0;
+
+		case SSL_ERROR_SYSCALL:
+			if(!ERR_peek_error()) {
+				if(rc == 0) {
+					// Closed without close_notify.
+					return 0;
+				}
+				throw system_error(errno,system_category(),hostname);
+			}
+			// Fall through.
+
+		default:
+			{
+				char text[256];
+				ERR_error_string_n(ERR_get_error(),text,sizeof(text));
+				throw runtime_error(Logger::String{hostname,": ",text});
+			}
+		}
+
+	}
+#endif // HAVE_LIBSSL
+
+	static ssize_t send_some(CivetWeb::Engine::Request &request) {
+
+		const char *data = request.output.c_str() + request.sent;
+		size_t length = request.output.size() - request.sent;
+
+#ifdef HAVE_LIBSSL
+		if(request.ssl) {
+			ERR_clear_error();
+			int rc = SSL_write(request.ssl,data,(int) length);
+			return (rc > 0 ? (ssize_t) rc : ssl_result(request.ssl,rc,request.hostname));
+		}
+#endif // HAVE_LIBSSL
+
+		ssize_t rc = ::send(request.fd,data,length,MSG_NOSIGNAL);
+		if(rc >= 0) {
+			return rc;
+		}
+
+		if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return WantWrite;
+		}
+
+		throw system_error(errno,system_category(),request.hostname);
+
+	}
+
+	static ssize_t recv_some(CivetWeb::Engine::Request &request, char *data, size_t length) {
+
+#ifdef HAVE_LIBSSL
+		if(request.ssl) {
+			ERR_clear_error();
+			int rc = SSL_read(request.ssl,data,(int) length);
+			return (rc > 0 ? (ssize_t) rc : ssl_result(request.ssl,rc,request.hostname));
+		}
+#endif // HAVE_LIBSSL
+
+		ssize_t rc = ::recv(request.fd,data,length,0);
+		if(rc >= 0) {
+			return rc;
+		}
+
+		if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return WantRead;
+		}
+
+		throw system_error(errno,system_category(),request.hostname);
+
+	}
+
+	/// @brief Parse the received data.
+	/// @return true when the response is complete.
+	static bool parse(CivetWeb::Engine::Request &request, bool eof) {
+
+		using Request = CivetWeb::Engine::Request;
+
+		while(request.state == Request::Headers) {
+
+			size_t end = request.input.find("\r\n\r\n");
+			if(end == string::npos) {
+				if(request.input.size() > 65536) {
+					throw runtime_error("Response header is too long");
+				}
+				return false;
+			}
+
+			const char *ptr = request.input.c_str();
+			if(strncmp(ptr,"HTTP/1.",7) || end < 12) {
+				throw runtime_error("Invalid server response");
+			}
+
+			request.result.status = atoi(ptr+9);
+			{
+				size_t eol = request.input.find("\r\n");
+				request.result.text = (eol > 13 ? request.input.substr(13,eol-13) : "");
+			}
+
+			// Headers.
+			request.length = -1;
+			request.chunked = false;
+
+			size_t from = request.input.find("\r\n") + 2;
+			while(from < end) {
+
+				size_t eol = request.input.find("\r\n",from);
+				string line{request.input,from,eol-from};
+				from = eol + 2;
+
+				auto colon = line.find(':');
+				if(colon == string::npos) {
+					continue;
+				}
+
+				string name{line,0,colon};
+				const char *value = line.c_str() + colon + 1;
+				while(*value && isspace(*value)) {
+					value++;
+				}
+
+				if(!strcasecmp(name.c_str(),"Content-Length")) {
+					request.length = atoll(value);
+				} else if(!strcasecmp(name.c_str(),"Transfer-Encoding") && strstr(value,"chunked")) {
+					request.chunked = true;
+				}
+
+			}
+
+			request.input.erase(0,end+4);
+
+			if(request.result.status >= 100 && request.result.status < 200) {
+				// Interim response, wait for the next one.
+				request.result.status = 0;
+				continue;
+			}
+
+			if(request.head || request.result.status == 204 || request.result.status == 304) {
+				return true;
+			}
+
+			request.state = Request::Body;
+
+		}
+
+		if(request.chunked) {
+
+			for(;;) {
+
+				if(request.last) {
+					// Skip trailers.
+					if(request.input.compare(request.position,2,"\r\n") == 0 || request.input.find("\r\n\r\n",request.position) != string::npos) {
+						return true;
+					}
+					break;
+				}
+
+				if(request.chunk <= 0) {
+
+					size_t eol = request.input.find("\r\n",request.position);
+					if(eol == string::npos) {
+						break;
+					}
+
+					request.chunk = CivetWeb::Client::chunksize(request.input.c_str()+request.position);
+					request.position = eol + 2;
+
+					if(request.chunk <= 0) {
+						request.last = true;
+						continue;
+					}
+
+				}
+
+				if(request.input.size() < request.position + request.chunk + 2) {
+					break;
+				}
+
+				request.result.body.append(request.input,request.position,request.chunk);
+				request.position += request.chunk + 2;
+				request.chunk = 0;
+
+			}
+
+			if(request.position > 65536) {
+				request.input.erase(0,request.position);
+				request.position = 0;
+			}
+
+			if(eof) {
+				throw system_error(ECONNRESET,system_category(),"Connection closed while reading chunk");
+			}
+
+			return false;
+
+		}
+
+		if(request.length >= 0) {
+
+			if((long long) request.input.size() >= request.length) {
+				request.input.resize(request.length);
+				request.result.body = std::move(request.input);
+				return true;
+			}
+
+			if(eof) {
+				throw system_error(ECONNRESET,system_category(),"Connection closed while reading response");
+			}
+
+			return false;
+
+		}
+
+		// Body ends when the server closes the connection.
+		if(eof) {
+			request.result.body = std::move(request.input);
+			return true;
+		}
+
+		return false;
+
+	}
+
+	/// @brief Start connecting to the current address, try the next ones on immediate failures.
+	static void open(CivetWeb::Engine::Request &request) {
+
+		for(;;) {
+
+			const CivetWeb::Resolver::Address &address = (*request.addresses)[request.current];
+
+			try {
+
+				request.fd = socket(address.addr.ss_family,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,0);
+				if(request.fd < 0) {
+					throw system_error(errno,system_category(),"socket");
+				}
+
+				int flag = 1;
+				setsockopt(request.fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+				if(::connect(request.fd,(const struct sockaddr *) &address.addr,address.length) != 0 && errno != EINPROGRESS) {
+					throw system_error(errno,system_category(),request.hostname);
+				}
+
+				return;
+
+			} catch(...) {
+
+				request.close();
+				if(++request.current >= request.addresses->size()) {
+					CivetWeb::Resolver::getInstance().forget(request.hostname.c_str(),request.port);
+					throw;
+				}
+
+			}
+
+		}
+
+	}
+
+	/// @brief Run the request state machine.
+	/// @return The epoll events to wait for, 0 when finished.
+	static uint32_t step(CivetWeb::Engine::Request &request) {
+
+		using Request = CivetWeb::Engine::Request;
+
+		for(;;) {
+
+			switch(request.state) {
+			case Request::Connecting:
+				{
+					int error = 0;
+					socklen_t length = sizeof(error);
+					getsockopt(request.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+					if(error) {
+
+						request.close();
+						if(++request.current >= request.addresses->size()) {
+							CivetWeb::Resolver::getInstance().forget(request.hostname.c_str(),request.port);
+							throw system_error(error,system_category(),request.hostname);
+						}
+
+						// Try the next address.
+						Logger::String{request.hostname,": ",strerror(error),", trying the next address"}.trace("civetweb");
+						open(request);
+						return EPOLLOUT;
+
+					}
+
+					if(strcasecmp(request.scheme.c_str(),"https") == 0) {
+#ifdef HAVE_LIBSSL
+						request.ssl = SSL_new(CivetWeb::Session::context());
+						if(!request.ssl) {
+							throw runtime_error("Cant create TLS session");
+						}
+						SSL_set_fd(request.ssl,request.fd);
+						CivetWeb::Session::expect(request.ssl,request.hostname.c_str());
+						request.key = request.scheme + "://" + request.hostname + ":" + std::to_string(request.port);
+						CivetWeb::TLSCache::getInstance().prepare(request.ssl,request.key);
+						request.state = Request::Handshake;
+#else
+						throw system_error(ENOTSUP,system_category(),"Built without TLS support");
+#endif // HAVE_LIBSSL
+					} else {
+						request.state = Request::Sending;
+					}
+				}
+				break;
+
+#ifdef HAVE_LIBSSL
+			case Request::Handshake:
+				{
+					ERR_clear_error();
+					int rc = SSL_connect(request.ssl);
+					if(rc != 1) {
+						try {
+							return (ssl_result(request.ssl,rc,request.hostname) == WantWrite ? EPOLLOUT : EPOLLIN);
+						} catch(...) {
+							CivetWeb::TLSCache::getInstance().forget(request.key);
+							throw;
+						}
+					}
+					CivetWeb::TLSCache::getInstance().handshake(request.ssl);
+					request.state = Request::Sending;
+				}
+				break;
+#endif // HAVE_LIBSSL
+
+			case Request::Sending:
+				while(request.sent < request.output.size()) {
+					ssize_t rc = send_some(request);
+					if(rc == WantRead) {
+						return EPOLLIN;
+					} else if(rc == WantWrite) {
+						return EPOLLOUT;
+					} else if(rc == 0) {
+						throw system_error(ECONNRESET,system_category(),request.hostname);
+					}
+					request.sent += (size_t) rc;
+				}
+				request.state = Request::Headers;
+				break;
+
+			case Request::Headers:
+			case Request::Body:
+				{
+					char buffer[16384];
+					bool eof = false;
+
+					for(;;) {
+						ssize_t rc = recv_some(request,buffer,sizeof(buffer));
+						if(rc == WantRead || rc == WantWrite) {
+							if(parse(request,false)) {
+								return 0;
+							}
+							return (rc == WantWrite ? EPOLLOUT : EPOLLIN);
+						} else if(rc == 0) {
+							eof = true;
+							break;
+						}
+						request.input.append(buffer,(size_t) rc);
+					}
+
+					if(parse(request,eof)) {
+						return 0;
+					}
+
+					throw system_error(ECONNRESET,system_category(),"Connection closed by server");
+				}
+
+			default:
+				return 0;
+
+			}
+
+		}
+
+	}
+
+	void CivetWeb::Engine::start() {
+
+		lock_guard<mutex> lock(guard);
+
+		if(thread) {
+			return;
+		}
+
+		epfd = epoll_create1(EPOLL_CLOEXEC);
+		if(epfd < 0) {
+			throw system_error(errno,system_category(),"Cant create epoll");
+		}
+
+		evfd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+		if(evfd < 0) {
+			int error = errno;
+			::close(epfd);
+			epfd = -1;
+			throw system_error(error,system_category(),"Cant create eventfd");
+		}
+
+		struct epoll_event event;
+		memset(&event,0,sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		epoll_ctl(epfd,EPOLL_CTL_ADD,evfd,&event);
+
+		running = true;
+		thread = new std::thread([this](){
+			run();
+		});
+
+	}
+
+	void CivetWeb::Engine::stop() {
+
+		std::thread *engine = nullptr;
+
+		{
+			lock_guard<mutex> lock(guard);
+			running = false;
+			engine = thread;
+			thread = nullptr;
+			if(evfd >= 0) {
+				uint64_t value = 1;
+				if(::write(evfd,&value,sizeof(value)) < 0) {
+					// Ignore, the engine wakes up on the next timeout.
+				}
+			}
+		}
+
+		if(engine) {
+			engine->join();
+			delete engine;
+		}
+
+		lock_guard<mutex> lock(guard);
+
+		if(evfd >= 0) {
+			::close(evfd);
+			evfd = -1;
+		}
+
+		if(epfd >= 0) {
+			::close(epfd);
+			epfd = -1;
+		}
+
+	}
+
+	void CivetWeb::Engine::push(std::shared_ptr<Request> request) {
+
+		counters.started++;
+		counters.active++;
+
+		// Resolve on the caller thread, the engine never blocks.
+		try {
+
+			request->addresses = Resolver::getInstance().resolve(request->hostname.c_str(),request->port);
+			if(!(request->addresses && !request->addresses->empty())) {
+				throw system_error(EHOSTUNREACH,system_category(),request->hostname);
+			}
+
+		} catch(const std::exception &e) {
+
+			request->result.error = EHOSTUNREACH;
+			request->result.message = e.what();
+			finish(request);
+			return;
+
+		}
+
+		try {
+
+			start();
+
+		} catch(const std::exception &e) {
+
+			request->result.error = EIO;
+			request->result.message = e.what();
+			finish(request);
+			return;
+
+		}
+
+		lock_guard<mutex> lock(guard);
+		queue.push_back(request);
+
+		uint64_t value = 1;
+		if(::write(evfd,&value,sizeof(value)) < 0) {
+			// Ignore, the engine checks the queue on every wakeup.
+		}
+
+	}
+
+	void CivetWeb::Engine::run() {
+
+		Logger::String{"Client engine started"}.trace("civetweb");
+
+		std::list<std::shared_ptr<Request>> active;
+
+		auto fail = [this](std::shared_ptr<Request> request, int error, const char *message) {
+			request->result.status = 0;
+			request->result.error = error;
+			request->result.message = message;
+			finish(request);
+		};
+
+		auto wait = [this](Request &request, uint32_t events) {
+			struct epoll_event event;
+			memset(&event,0,sizeof(event));
+			event.events = events;
+			event.data.ptr = &request;
+			// A new socket (next address) must be added again.
+			if(epoll_ctl(epfd,(request.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD),request.fd,&event) != 0) {
+				throw system_error(errno,system_category(),"epoll_ctl");
+			}
+			request.registered = true;
+		};
+
+		for(;;) {
+
+			std::list<std::shared_ptr<Request>> incoming;
+			{
+				lock_guard<mutex> lock(guard);
+				if(!running) {
+					break;
+				}
+				incoming.swap(queue);
+			}
+
+			// Start the new requests.
+			for(auto &request : incoming) {
+
+				try {
+
+					open(*request);
+					wait(*request,EPOLLOUT);
+					active.push_back(request);
+
+				} catch(const std::system_error &e) {
+
+					fail(request,e.code().value(),e.what());
+
+				} catch(const std::exception &e) {
+
+					fail(request,EIO,e.what());
+
+				}
+
+			}
+
+			// Wait for the nearest deadline.
+			auto now = steady_clock::now();
+			int timeout = 1000;
+			for(auto &request : active) {
+				auto remaining = duration_cast<milliseconds>(request->deadline - now).count();
+				if(remaining < timeout) {
+					timeout = (int) std::max(remaining,(decltype(remaining)) 0);
+				}
+			}
+
+			struct epoll_event events[64];
+			int count = epoll_wait(epfd,events,64,timeout);
+
+			for(int ix = 0; ix < count; ix++) {
+
+				Request *request = (Request *) events[ix].data.ptr;
+
+				if(!request) {
+					uint64_t value;
+					if(::read(evfd,&value,sizeof(value)) < 0) {
+						// Ignore, nothing pending.
+					}
+					continue;
+				}
+
+				auto it = std::find_if(active.begin(),active.end(),[request](const std::shared_ptr<Request> &item){
+					return item.get() == request;
+				});
+
+				if(it == active.end() || request->state == Request::Done) {
+					continue;
+				}
+
+				try {
+
+					uint32_t wanted = step(*request);
+					if(wanted) {
+						wait(*request,wanted);
+					} else {
+						finish(*it);
+					}
+
+				} catch(const std::system_error &e) {
+
+					fail(*it,e.code().value(),e.what());
+
+				} catch(const std::exception &e) {
+
+					fail(*it,EIO,e.what());
+
+				}
+
+			}
+
+			// Timeouts and finished requests.
+			now = steady_clock::now();
+			for(auto it = active.begin(); it != active.end();) {
+
+				if((*it)->state != Request::Done && (*it)->deadline <= now) {
+					fail(*it,ETIMEDOUT,"Timeout");
+				}
+
+				if((*it)->state == Request::Done) {
+					it = active.erase(it);
+				} else {
+					it++;
+				}
+
+			}
+
+		}
+
+		// Stopped, cancel the pending requests.
+		{
+			lock_guard<mutex> lock(guard);
+			for(auto &request : queue) {
+				active.push_back(request);
+			}
+			queue.clear();
+		}
+
+		for(auto &request : active) {
+			if(request->state != Request::Done) {
+				fail(request,ECANCELED,"Client engine stopped");
+			}
+		}
+
+		Logger::String{"Client engine stopped"}.trace("civetweb");
+
+	}
+
+#endif // _WIN32
+
+ }
@@ -19,6 +19,7 @@
 
  #include <config.h>
  #include <private/module.h>
+ #include <private/httpcache.h>
  #include <udjat/tools/configuration.h>
  #include <udjat/tools/http/exception.h>
  #include <udjat/tools/protocol.h>
@@ -36,69 +37,173 @@
 
 			progress(0,0);
 
-			struct mg_connection *conn = connect();
+			// Plain GETs go through the response cache.
+			auto &cache = HttpCache::getInstance();
+			const std::string key{url().c_str()};
+			std::shared_ptr<const HttpCache::Entry> cached;
 
-			Udjat::String response;
+			bool cacheable = cache.enabled()
+				&& strcasecmp(std::to_string(method()),"GET") == 0
+				&& !(get_payload() && *get_payload())
+				&& !requested("Range")
+				&& !requested("If-None-Match")
+				&& !requested("If-Modified-Since")
+				&& !requested("Accept-Encoding")
+				&& !credentials();
+
+			// Validators set here are removed after the request, the worker can be reused.
+			std::list<std::string> added;
+
+			if(cacheable) {
+
+				const char *control = requested("Cache-Control");
+
+				if(control && strstr(control,"no-store")) {
+
+					cacheable = false;
+
+				} else if((cached = cache.find(key)) != nullptr) {
+
+					if(!(control && strstr(control,"no-cache")) && cached->fresh(time(0))) {
+
+						cache.hit();
+						replace(cached->headers);
+
+						Udjat::String response;
+						response.assign(cached->body);
+						progress((double) response.size(), (double) response.size());
+						return response;
+
+					}
+
+					// Stale, revalidate.
+					const char *validator = cached->header("ETag");
+					if(validator) {
+						request("If-None-Match") = validator;
+						added.emplace_back("If-None-Match");
+					}
+
+					validator = cached->header("Last-Modified");
+					if(validator) {
+						request("If-Modified-Since") = validator;
+						added.emplace_back("If-Modified-Since");
+					}
+
+				}
+
+			}
+
+			time_t request_time = time(0);
+
+			std::unique_ptr<Client> client;
 			try {
+				client = connect();
+			} catch(...) {
+				for(const std::string &name : added) {
+					unset(name.c_str());
+				}
+				throw;
+			}
+
+			for(const std::string &name : added) {
+				unset(name.c_str());
+			}
+
+			if(client->status == 304 && cached && !added.empty()) {
+
+				// Not modified, the cached response is still valid.
+				auto updated = cache.refresh(cached,client->headers,request_time);
+				replace(updated->headers);
+
+				Udjat::String response;
+				response.assign(updated->body);
+				progress((double) response.size(), (double) response.size());
+				return response;
 
-				const struct mg_response_info *info = mg_get_response_info(conn);
+			}
+
+			Udjat::String response;
 
-				debug("Server response was '", info->status_code, " ", info->status_text, "'");
+			debug("Server response was '", client->status, " ", client->text, "'");
 
-				if(info->status_code < 200 || info->status_code > 299) {
+			if(client->status < 200 || client->status > 299) {
 
-					throw HTTP::Exception(info->status_code, info->status_text);
+				throw HTTP::Exception(client->status, client->text.c_str());
 
-				} else if((unsigned int) info->content_length >= response.max_size()) {
+			} else if(client->length > 0 && (unsigned long long) client->length >= response.max_size()) {
 
-					throw system_error(E2BIG,system_category(),"The response is too big for current implementation");
+				throw system_error(E2BIG,system_category(),"The response is too big for current implementation");
 
-				} else if(info->content_length > 0) {
+			}
 
-					progress((double) 0, (double) info->content_length);
-					char * buffer = new char [info->content_length + 1];
-					memset(buffer,0,info->content_length + 1);
+			// Chunked, close delimited and decoded bodies have no length, read until the end.
+			// The progress is on the bytes received from the server.
+			double total = (double) (client->wire.length > 0 ? client->wire.length : 0);
 
-					long long loaded = 0;
+			if(client->length > 0) {
+				response.reserve(client->length);
+			}
 
-					try {
-						while(loaded < info->content_length) {
+			progress(0,total);
 
-							int szRead = mg_read(conn, (void *) (buffer+loaded), 1024);
+			// The body is read straight into the response, larger reads as it grows.
+			size_t chunk = 16384;
 
-							if(szRead == 0) {
-								throw system_error(ENOTCONN,system_category(),"Connection closed while downloading file");
-							} else if(szRead < 0) {
-								throw runtime_error("Download error");
-							} else {
-								loaded += (size_t) szRead;
-								if(!progress((double) loaded, (double) info->content_length)) {
-									throw system_error(ECANCELED,system_category());
-								}
-							}
+			for(;;) {
 
-						}
+				size_t used = response.size();
+				size_t length = chunk;
 
-					} catch(...) {
-						delete[] buffer;
-						throw;
+				if(client->length > 0) {
+					if(used >= (size_t) client->length) {
+						break;
 					}
+					length = std::min(length,((size_t) client->length) - used);
+				}
 
-					buffer[info->content_length] = 0;
-					response.assign(buffer);
-					delete[] buffer;
+				response.resize(used + length);
 
-					progress((double) info->content_length, (double) info->content_length);
+				size_t bytes = client->read(&response[used],length);
+				response.resize(used + bytes);
 
+				if(!bytes) {
+					break;
 				}
 
-			} catch(...) {
+				if(!progress((double) client->wire.received, total)) {
+					throw system_error(ECANCELED,system_category());
+				}
 
-				mg_close_connection(conn);
-				throw;
+				if(bytes == length && chunk < 1048576) {
+					chunk *= 2;
+				}
+
+			}
+
+			if(client->decoding()) {
+				Logger::String{"Received ",client->wire.received," bytes, decoded to ",client->decoded}.trace("civetweb");
+			}
+
+			if(cacheable && cache.fits(response.size())) {
+				auto entry = make_shared<HttpCache::Entry>();
+				entry->url = key;
+				entry->status = client->status;
+				entry->text = client->text;
+				entry->body = response;
+
+				// The body is stored decoded and without the transfer framing.
+				for(const auto &header : client->headers) {
+					const char *name = header.first.c_str();
+					if(!strcasecmp(name,"Transfer-Encoding") || (client->decoding() && (!strcasecmp(name,"Content-Encoding") || !strcasecmp(name,"Content-Length")))) {
+						continue;
+					}
+					entry->headers.push_back(header);
+				}
+
+				cache.store(entry,request_time);
 			}
 
-			mg_close_connection(conn);
+			progress((double) response.size(), (double) response.size());
 
 			return response;
 		}
@@ -0,0 +1,571 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client response cache.
+  *
+  * Private cache as in RFC 9111: only GET responses with status 200 are
+  * kept, freshness comes from max-age, Expires or (heuristic, when enabled)
+  * 10% of the Last-Modified age; stale entries are revalidated with If-None-Match
+  * and If-Modified-Since. Entries are immutable, a revalidation replaces
+  * them. The disk tier keeps one file per url for the entries in the memory
+  * tier, the files are removed when the entry is evicted.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/httpcache.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/http/timestamp.h>
+ #include <sys/types.h>
+ #include <sys/stat.h>
+ #include <dirent.h>
+ #include <fstream>
+ #include <sstream>
+ #include <functional>
+ #include <algorithm>
+ #include <vector>
+ #include <cstring>
+ #include <cstdio>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Largest heuristic freshness (one day).
+	static const time_t heuristic_limit = 86400;
+
+	/// @brief Find Cache-Control directive.
+	/// @param value The header value.
+	/// @param name The directive name.
+	/// @param argument The directive argument (if any).
+	/// @return true if the directive was found.
+	static bool directive(const char *value, const char *name, long long *argument = nullptr) {
+
+		if(!value) {
+			return false;
+		}
+
+		size_t length = strlen(name);
+
+		while(*value) {
+
+			while(*value && (isspace(*value) || *value == ',')) {
+				value++;
+			}
+
+			if(!strncasecmp(value,name,length) && (!value[length] || value[length] == '=' || value[length] == ',' || isspace(value[length]))) {
+				if(argument) {
+					*argument = (value[length] == '=' ? atoll(value + length + 1 + (value[length+1] == '"' ? 1 : 0)) : -1);
+				}
+				return true;
+			}
+
+			while(*value && *value != ',') {
+				value++;
+			}
+
+		}
+
+		return false;
+
+	}
+
+	/// @brief Parse HTTP date.
+	/// @return The time, 0 if invalid.
+	static time_t timeof(const char *value) noexcept {
+
+		if(!(value && *value)) {
+			return 0;
+		}
+
+		try {
+			return (time_t) HTTP::TimeStamp(value);
+		} catch(...) {
+			return 0;
+		}
+
+	}
+
+	const char * CivetWeb::HttpCache::Entry::header(const char *name) const noexcept {
+		for(const auto &header : headers) {
+			if(!strcasecmp(header.first.c_str(),name)) {
+				return header.second.c_str();
+			}
+		}
+		return nullptr;
+	}
+
+	bool CivetWeb::HttpCache::Entry::fresh(time_t now) const noexcept {
+		if(revalidate) {
+			return false;
+		}
+		time_t age = initial_age + (now > response_time ? now - response_time : 0);
+		return age < lifetime;
+	}
+
+	void CivetWeb::HttpCache::Entry::update(time_t request_time, time_t now, bool heuristic) {
+
+		time_t date = timeof(header("Date"));
+		if(!date) {
+			date = now;
+		}
+
+		// RFC 9111 4.2.3
+		time_t age = 0;
+		{
+			const char *value = header("Age");
+			if(value) {
+				age = (time_t) std::max(atoll(value),0LL);
+			}
+		}
+
+		time_t apparent = (now > date ? now - date : 0);
+		time_t corrected = age + (now > request_time ? now - request_time : 0);
+
+		initial_age = std::max(apparent,corrected);
+		response_time = now;
+
+		const char *control = header("Cache-Control");
+		revalidate = directive(control,"no-cache");
+
+		long long maxage = -1;
+		if(directive(control,"max-age",&maxage) && maxage >= 0) {
+
+			lifetime = (time_t) maxage;
+
+		} else if(header("Expires")) {
+
+			// Invalid dates (as "0") are in the past.
+			time_t expires = timeof(header("Expires"));
+			lifetime = (expires > date ? expires - date : 0);
+
+		} else if(heuristic) {
+
+			time_t modified = timeof(header("Last-Modified"));
+			lifetime = (modified && modified < date ? std::min((date - modified) / 10, heuristic_limit) : 0);
+
+		} else {
+
+			// No explicit lifetime, always revalidate.
+			lifetime = 0;
+
+		}
+
+	}
+
+	CivetWeb::HttpCache::HttpCache() {
+	}
+
+	CivetWeb::HttpCache & CivetWeb::HttpCache::getInstance() {
+		static HttpCache instance;
+		return instance;
+	}
+
+	void CivetWeb::HttpCache::setup() {
+
+		lock_guard<mutex> lock(guard);
+
+		limits.enabled = Config::Value<bool>("http-client","cache",false);
+		limits.heuristic = Config::Value<bool>("http-client","cache-heuristic",false);
+		limits.memory = Config::Value<unsigned int>("http-client","cache-memory",8388608);
+		limits.entry = Config::Value<unsigned int>("http-client","cache-max-entry",1048576);
+		limits.path = Config::Value<std::string>("http-client","cache-path","");
+
+		if(!limits.path.empty()) {
+
+			while(limits.path.size() > 1 && (limits.path.back() == '/' || limits.path.back() == '\\')) {
+				limits.path.pop_back();
+			}
+
+#ifdef _WIN32
+			mkdir(limits.path.c_str());
+#else
+			mkdir(limits.path.c_str(),0700);
+#endif // _WIN32
+
+			struct stat st;
+			if(stat(limits.path.c_str(),&st) || !S_ISDIR(st.st_mode)) {
+				Logger::String{"Cant use '",limits.path,"' for the response cache, disk tier disabled"}.warning("civetweb");
+				limits.path.clear();
+			} else {
+				trim();
+			}
+
+		}
+
+		entries.clear();
+		index.clear();
+		used = 0;
+
+	}
+
+	void CivetWeb::HttpCache::trim() noexcept {
+
+		// Files from the previous runs, the most recent ones are kept up to the memory tier size.
+		struct Cached {
+			std::string name;
+			time_t mtime;
+			size_t size;
+		};
+
+		std::vector<Cached> files;
+
+		DIR *dir = opendir(limits.path.c_str());
+		if(!dir) {
+			return;
+		}
+
+		try {
+
+			struct dirent *ent;
+			while((ent = readdir(dir)) != NULL) {
+
+				string name{limits.path + "/" + ent->d_name};
+				size_t length = strlen(ent->d_name);
+
+				if(length > 4 && !strcmp(ent->d_name+length-4,".tmp")) {
+					// Interrupted save.
+					::remove(name.c_str());
+					continue;
+				}
+
+				struct stat st;
+				if(length > 6 && !strcmp(ent->d_name+length-6,".cache") && !stat(name.c_str(),&st) && S_ISREG(st.st_mode)) {
+					files.push_back(Cached{name,st.st_mtime,(size_t) st.st_size});
+				}
+
+			}
+
+		} catch(const std::exception &e) {
+
+			Logger::String{"Cant check the response cache files: ",e.what()}.warning("civetweb");
+
+		}
+
+		closedir(dir);
+
+		std::sort(files.begin(),files.end(),[](const Cached &a, const Cached &b){
+			return a.mtime > b.mtime;
+		});
+
+		size_t total = 0;
+		for(const Cached &file : files) {
+			total += file.size;
+			if(total > limits.memory) {
+				::remove(file.name.c_str());
+			}
+		}
+
+	}
+
+	std::string CivetWeb::HttpCache::directory() const {
+		lock_guard<mutex> lock(guard);
+		return limits.path;
+	}
+
+	std::string CivetWeb::HttpCache::filename(const std::string &path, const std::string &url) {
+		char name[40];
+		snprintf(name,sizeof(name),"%016llx.cache",(unsigned long long) std::hash<std::string>{}(url));
+		return path + "/" + name;
+	}
+
+	std::shared_ptr<const CivetWeb::HttpCache::Entry> CivetWeb::HttpCache::load(const std::string &url) const {
+
+		string path{directory()};
+		if(path.empty()) {
+			return std::shared_ptr<const Entry>();
+		}
+
+		std::ifstream file{filename(path,url),std::ios::binary};
+		if(!file) {
+			return std::shared_ptr<const Entry>();
+		}
+
+		auto entry = make_shared<Entry>();
+
+		string line;
+		if(!(std::getline(file,line) && line == "udjat-http-cache 2" && std::getline(file,entry->url) && entry->url == url)) {
+			// Other url with the same hash or other format.
+			return std::shared_ptr<const Entry>();
+		}
+
+		size_t length = 0;
+		size_t count = 0;
+		{
+			std::getline(file,line);
+			std::istringstream values{line};
+			values >> entry->status >> entry->response_time >> entry->initial_age >> entry->lifetime >> entry->revalidate >> count >> length;
+		}
+
+		if(length > limits.entry) {
+			// From a larger 'cache-max-entry' or damaged, don't allocate it.
+			return std::shared_ptr<const Entry>();
+		}
+
+		std::getline(file,entry->text);
+
+		while(count-- && std::getline(file,line)) {
+			auto colon = line.find(':');
+			if(colon != string::npos) {
+				entry->headers.emplace_back(line.substr(0,colon),line.substr(colon+1));
+			}
+		}
+
+		entry->body.resize(length);
+		if(!file.read(&entry->body[0],length)) {
+			return std::shared_ptr<const Entry>();
+		}
+
+		return entry;
+
+	}
+
+	void CivetWeb::HttpCache::save(const Entry &entry) const noexcept {
+
+		string path;
+		try {
+			path = directory();
+		} catch(...) {
+			return;
+		}
+
+		if(path.empty()) {
+			return;
+		}
+
+		string name{filename(path,entry.url)};
+		string temp{name + ".tmp"};
+
+		{
+			std::ofstream file{temp,std::ios::binary|std::ios::trunc};
+			if(!file) {
+				return;
+			}
+
+			file	<< "udjat-http-cache 2\n"
+					<< entry.url << "\n"
+					<< entry.status << " " << entry.response_time << " " << entry.initial_age << " "
+					<< entry.lifetime << " " << entry.revalidate << " " << entry.headers.size() << " "
+					<< entry.body.size() << "\n"
+					<< entry.text << "\n";
+
+			for(const auto &header : entry.headers) {
+				file << header.first << ":" << header.second << "\n";
+			}
+
+			file.write(entry.body.c_str(),entry.body.size());
+
+			if(!file) {
+				file.close();
+				::remove(temp.c_str());
+				return;
+			}
+		}
+
+#ifdef _WIN32
+		::remove(name.c_str());
+#endif // _WIN32
+
+		if(::rename(temp.c_str(),name.c_str())) {
+			::remove(temp.c_str());
+		}
+
+	}
+
+	void CivetWeb::HttpCache::insert(std::shared_ptr<const Entry> entry) {
+
+		auto it = index.find(entry->url);
+		if(it != index.end()) {
+			used -= (*it->second)->body.size();
+			entries.erase(it->second);
+			index.erase(it);
+		}
+
+		entries.push_front(entry);
+		index[entry->url] = entries.begin();
+		used += entry->body.size();
+
+		// Least recently used last, the disk tier keeps only the memory entries.
+		while(used > limits.memory && entries.size() > 1) {
+			used -= entries.back()->body.size();
+			if(!limits.path.empty()) {
+				::remove(filename(limits.path,entries.back()->url).c_str());
+			}
+			index.erase(entries.back()->url);
+			entries.pop_back();
+			counters.evicted++;
+		}
+
+	}
+
+	std::shared_ptr<const CivetWeb::HttpCache::Entry> CivetWeb::HttpCache::find(const std::string &url) {
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			auto it = index.find(url);
+			if(it != index.end()) {
+				// Most recently used.
+				entries.splice(entries.begin(),entries,it->second);
+				return *it->second;
+			}
+		}
+
+		auto entry = load(url);
+		if(entry) {
+			counters.disk++;
+			lock_guard<mutex> lock(guard);
+			insert(entry);
+			return entry;
+		}
+
+		counters.misses++;
+		return entry;
+
+	}
+
+	void CivetWeb::HttpCache::store(std::shared_ptr<Entry> entry, time_t request_time) {
+
+		if(entry->status != 200 || entry->body.size() > limits.entry) {
+			return;
+		}
+
+		const char *control = entry->header("Cache-Control");
+		if(directive(control,"no-store")) {
+			remove(entry->url);
+			return;
+		}
+
+		// The body is decoded, only a Vary on the encoding can be used.
+		const char *vary = entry->header("Vary");
+		if(vary && (directive(vary,"*") || strcasecmp(vary,"Accept-Encoding"))) {
+			return;
+		}
+
+		entry->update(request_time,time(0),limits.heuristic);
+
+		if(!entry->lifetime && !entry->header("ETag") && !entry->header("Last-Modified")) {
+			// Can't be used nor revalidated.
+			return;
+		}
+
+		counters.stored++;
+
+		save(*entry);
+
+		lock_guard<mutex> lock(guard);
+		insert(entry);
+
+	}
+
+	std::shared_ptr<const CivetWeb::HttpCache::Entry> CivetWeb::HttpCache::refresh(std::shared_ptr<const Entry> entry, const std::list<std::pair<std::string,std::string>> &headers, time_t request_time) {
+
+		counters.revalidated++;
+
+		auto updated = make_shared<Entry>(*entry);
+
+		// RFC 9111 4.3.4, the stored headers are replaced by the new ones (not the framing).
+		for(const auto &header : headers) {
+
+			const char *name = header.first.c_str();
+			if(!strcasecmp(name,"Content-Length") || !strcasecmp(name,"Transfer-Encoding") || !strcasecmp(name,"Content-Encoding") || !strcasecmp(name,"Connection")) {
+				continue;
+			}
+
+			bool found = false;
+			for(auto &stored : updated->headers) {
+				if(!strcasecmp(stored.first.c_str(),name)) {
+					stored.second = header.second;
+					found = true;
+				}
+			}
+
+			if(!found) {
+				updated->headers.push_back(header);
+			}
+
+		}
+
+		if(directive(updated->header("Cache-Control"),"no-store")) {
+			remove(updated->url);
+			return updated;
+		}
+
+		updated->update(request_time,time(0),limits.heuristic);
+
+		save(*updated);
+
+		lock_guard<mutex> lock(guard);
+		insert(updated);
+
+		return updated;
+
+	}
+
+	void CivetWeb::HttpCache::remove(const std::string &url) noexcept {
+
+		{
+			lock_guard<mutex> lock(guard);
+			auto it = index.find(url);
+			if(it != index.end()) {
+				used -= (*it->second)->body.size();
+				entries.erase(it->second);
+				index.erase(it);
+			}
+		}
+
+		try {
+			string path{directory()};
+			if(!path.empty()) {
+				::remove(filename(path,url).c_str());
+			}
+		} catch(...) {
+		}
+
+	}
+
+	void CivetWeb::HttpCache::clear() noexcept {
+		lock_guard<mutex> lock(guard);
+		entries.clear();
+		index.clear();
+		used = 0;
+	}
+
+	void CivetWeb::HttpCache::get(Udjat::Value &value) {
+
+		value["enabled"] = (bool) limits.enabled;
+		value["heuristic"] = (bool) limits.heuristic;
+		value["hits"] = (double) counters.hits;
+		value["disk-loads"] = (double) counters.disk;
+		value["revalidated"] = (double) counters.revalidated;
+		value["misses"] = (double) counters.misses;
+		value["stored"] = (double) counters.stored;
+		value["evicted"] = (double) counters.evicted;
+
+		lock_guard<mutex> lock(guard);
+		value["disk"] = !limits.path.empty();
+		value["entries"] = (unsigned int) entries.size();
+		value["size"] = (unsigned int) used;
+
+	}
+
+ }
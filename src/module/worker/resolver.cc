@@ -0,0 +1,319 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client name resolution cache.
+  *
+  * getaddrinfo() doesn't report the record TTL, entries are kept for the
+  * configured time; failures are cached for a shorter one. The lookup runs
+  * without the lock, concurrent misses for the same host may both resolve.
+  * The limits are read under the lock, setup() runs again on reconfiguration.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/resolver.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/url.h>
+ #include <stdexcept>
+ #include <thread>
+ #include <cstring>
+
+#ifndef _WIN32
+	#include <netdb.h>
+#endif // !_WIN32
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	static std::string keyof(const char *hostname, unsigned int port) {
+		return std::string{hostname} + ":" + std::to_string(port);
+	}
+
+	CivetWeb::Resolver::Resolver() {
+	}
+
+	CivetWeb::Resolver::~Resolver() {
+		stop();
+	}
+
+	void CivetWeb::Resolver::stop() {
+
+		std::thread *thread = nullptr;
+
+		{
+			lock_guard<mutex> lock(guard);
+			thread = preresolver;
+			preresolver = nullptr;
+		}
+
+		if(thread) {
+			// The current lookup can't be interrupted, skip the next ones.
+			stopping = true;
+			thread->join();
+			delete thread;
+		}
+
+	}
+
+	CivetWeb::Resolver & CivetWeb::Resolver::getInstance() {
+		static Resolver instance;
+		return instance;
+	}
+
+	void CivetWeb::Resolver::setup() {
+
+		stop();
+
+		bool enabled = Config::Value<bool>("http-client","dns-cache",true);
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			limits.enabled = enabled;
+			limits.ttl = seconds(Config::Value<unsigned int>("http-client","dns-ttl",60));
+			limits.negative = seconds(Config::Value<unsigned int>("http-client","dns-negative-ttl",5));
+			limits.max_entries = std::max((unsigned int) Config::Value<unsigned int>("http-client","dns-max-entries",256),1U);
+
+			entries.clear();
+		}
+
+		if(!enabled) {
+			return;
+		}
+
+		// Pre-resolve the configured urls, without delaying the startup. The
+		// agent urls aren't known here: the module is loaded before the agent
+		// definitions and the url agents create their workers on each refresh,
+		// their hosts are cached on the first one.
+		std::vector<std::string> urls;
+		{
+			string list{Config::Value<std::string>("http-client","pre-resolve","")};
+
+			size_t from = 0;
+			while(from < list.size()) {
+				size_t to = list.find_first_of(" ,;\t",from);
+				if(to == string::npos) {
+					to = list.size();
+				}
+				if(to > from) {
+					urls.emplace_back(list,from,to-from);
+				}
+				from = to + 1;
+			}
+		}
+
+		if(urls.empty()) {
+			return;
+		}
+
+		stopping = false;
+
+		lock_guard<mutex> lock(guard);
+		preresolver = new std::thread{[this,urls](){
+
+			for(const std::string &url : urls) {
+
+				if(stopping) {
+					break;
+				}
+
+				try {
+
+					URL::Components components = URL{url.c_str()}.ComponentsFactory();
+					resolve(components.hostname.c_str(),components.portnumber());
+
+				} catch(const std::exception &e) {
+
+					Logger::String{"Cant pre-resolve '",url,"': ",e.what()}.warning("civetweb");
+
+				}
+
+			}
+
+		}};
+
+	}
+
+	CivetWeb::Resolver::Entry CivetWeb::Resolver::lookup(const char *hostname, unsigned int port) {
+
+		Entry entry;
+
+		struct addrinfo hints;
+		memset(&hints,0,sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		struct addrinfo *result = nullptr;
+		int rc = getaddrinfo(hostname,std::to_string(port).c_str(),&hints,&result);
+		if(rc || !result) {
+			entry.message = Logger::String{"Cant resolve '",hostname,"': ",(rc ? gai_strerror(rc) : "No address")};
+			return entry;
+		}
+
+		auto addresses = make_shared<std::vector<Address>>();
+
+		for(struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+
+			if(ai->ai_addrlen > sizeof(Address::addr)) {
+				continue;
+			}
+
+			Address address;
+			memset(&address.addr,0,sizeof(address.addr));
+			memcpy(&address.addr,ai->ai_addr,ai->ai_addrlen);
+			address.length = (socklen_t) ai->ai_addrlen;
+			address.family = ai->ai_family;
+			address.socktype = ai->ai_socktype;
+			address.protocol = ai->ai_protocol;
+			addresses->push_back(address);
+
+		}
+
+		freeaddrinfo(result);
+
+		if(addresses->empty()) {
+			entry.message = Logger::String{"Cant resolve '",hostname,"': No usable address"};
+		} else {
+			entry.addresses = addresses;
+		}
+
+		return entry;
+
+	}
+
+	void CivetWeb::Resolver::expire(const steady_clock::time_point &now) {
+
+		for(auto it = entries.begin(); it != entries.end();) {
+			if(it->second.expires <= now) {
+				it = entries.erase(it);
+			} else {
+				it++;
+			}
+		}
+
+		while(entries.size() >= limits.max_entries) {
+
+			auto oldest = entries.begin();
+			for(auto it = entries.begin(); it != entries.end(); it++) {
+				if(it->second.expires < oldest->second.expires) {
+					oldest = it;
+				}
+			}
+
+			entries.erase(oldest);
+			counters.evicted++;
+
+		}
+
+	}
+
+	CivetWeb::Resolver::Addresses CivetWeb::Resolver::resolve(const char *hostname, unsigned int port) {
+
+		string key{keyof(hostname,port)};
+
+		// Snapshot of the limits.
+		bool enabled;
+		seconds ttl, negative;
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			enabled = limits.enabled;
+			ttl = limits.ttl;
+			negative = limits.negative;
+
+			auto it = entries.find(key);
+			if(enabled && it != entries.end() && it->second.expires > steady_clock::now()) {
+
+				if(it->second.addresses) {
+					counters.hits++;
+					return it->second.addresses;
+				}
+
+				counters.negative++;
+				throw runtime_error(it->second.message);
+
+			}
+
+		}
+
+		counters.misses++;
+
+		Entry entry{lookup(hostname,port)};
+
+		if(!entry.addresses) {
+			counters.failures++;
+		}
+
+		if(enabled) {
+
+			auto now = steady_clock::now();
+			entry.expires = now + (entry.addresses ? ttl : negative);
+
+			lock_guard<mutex> lock(guard);
+			if(limits.enabled) {
+				entries.erase(key);
+				expire(now);
+				entries[key] = entry;
+			}
+
+		}
+
+		if(!entry.addresses) {
+			throw runtime_error(entry.message);
+		}
+
+		return entry.addresses;
+
+	}
+
+	void CivetWeb::Resolver::forget(const char *hostname, unsigned int port) noexcept {
+		lock_guard<mutex> lock(guard);
+		entries.erase(keyof(hostname,port));
+	}
+
+	void CivetWeb::Resolver::clear() noexcept {
+		lock_guard<mutex> lock(guard);
+		entries.clear();
+	}
+
+	void CivetWeb::Resolver::get(Udjat::Value &value) {
+
+		uint64_t hits = counters.hits + counters.negative;
+		uint64_t total = hits + counters.misses;
+
+		value["hits"] = (double) counters.hits;
+		value["negative-hits"] = (double) counters.negative;
+		value["misses"] = (double) counters.misses;
+		value["failures"] = (double) counters.failures;
+		value["evicted"] = (double) counters.evicted;
+		value["hit-rate"] = (total ? ((double) hits) / ((double) total) : 0.0);
+
+		lock_guard<mutex> lock(guard);
+		value["enabled"] = limits.enabled;
+		value["entries"] = (unsigned int) entries.size();
+
+	}
+
+ }
@@ -0,0 +1,414 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the worker download to file.
+  *
+  * The request is conditional on the current file (If-Modified-Since
+  * from its time, If-None-Match from the '.etag' sidecar); the body is
+  * written to '<filename>.part', an interrupted download is resumed with
+  * Range and If-Range using the validator kept in '<filename>.part.validator'.
+  *
+  * The '.part' file is locked (flock) while downloading, another download
+  * to the same file fails at once with EBUSY.
+  *
+  */
+
+ #include <config.h>
+ #include <private/module.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/http/exception.h>
+ #include <udjat/tools/protocol.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/http/timestamp.h>
+ #include <sys/types.h>
+ #include <sys/stat.h>
+ #include <utime.h>
+ #include <cstdio>
+ #include <cstdlib>
+ #include <fstream>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/file.h>
+#endif // !_WIN32
+
+ namespace Udjat {
+
+	 namespace CivetWeb {
+
+		/// @brief Read sidecar file.
+		static std::string load(const std::string &filename) {
+			std::string value;
+			std::ifstream file{filename};
+			if(file) {
+				std::getline(file,value);
+			}
+			return value;
+		}
+
+		/// @brief Write sidecar file, remove it if the value is empty.
+		static void store(const std::string &filename, const char *value) {
+
+			if(!(value && *value)) {
+				::remove(filename.c_str());
+				return;
+			}
+
+			std::ofstream file{filename,std::ofstream::trunc};
+			file << value << std::endl;
+
+		}
+
+#ifndef _WIN32
+		/// @brief Exclusive lock on the partial file.
+		class PartialLock {
+		private:
+			const std::string &filename;
+			int fd;
+
+		public:
+			PartialLock(const std::string &f) : filename{f}, fd{::open(f.c_str(),O_RDWR|O_CREAT,0644)} {
+
+				if(fd < 0) {
+					throw system_error(errno,system_category(),filename);
+				}
+
+				if(flock(fd,LOCK_EX|LOCK_NB)) {
+					int error = errno;
+					::close(fd);
+					if(error == EWOULDBLOCK) {
+						throw system_error(EBUSY,system_category(),Logger::String{"'",filename,"' is being downloaded"});
+					}
+					throw system_error(error,system_category(),filename);
+				}
+
+			}
+
+			~PartialLock() {
+
+				// Don't leave an empty partial file (if it's still ours).
+				struct stat locked, current;
+				if(fstat(fd,&locked) == 0 && locked.st_size == 0
+					&& stat(filename.c_str(),&current) == 0
+					&& current.st_ino == locked.st_ino && current.st_dev == locked.st_dev) {
+					::remove(filename.c_str());
+				}
+
+				::close(fd);
+
+			}
+
+		};
+#endif // !_WIN32
+
+		bool Worker::save(const char *filename, const std::function<bool(double current, double total)> &progress, bool replace) {
+
+			progress(0,0);
+
+			const std::string partial{std::string{filename} + ".part"};
+			const std::string validator{partial + ".validator"};
+			const std::string etag{std::string{filename} + ".etag"};
+
+#ifndef _WIN32
+			// Before checking the partial file, it can be from a download in progress.
+			std::unique_ptr<PartialLock> lock{new PartialLock(partial)};
+#endif // !_WIN32
+
+			bool resume = Config::Value<bool>("http-client","resume",true);
+
+			// Headers set here are removed after the request, the worker can be reused.
+			std::list<std::string> added;
+			auto set = [this,&added](const char *name, const std::string &value) {
+				Protocol::Header &header = request(name);
+				if(header.empty()) {
+					header = value;
+					added.emplace_back(name);
+				}
+			};
+
+			struct stat st;
+
+			if(Config::Value<bool>("http-client","conditional",true) && stat(filename,&st) == 0) {
+
+				set("If-Modified-Since",HTTP::TimeStamp(st.st_mtime).to_string());
+
+				std::string value{load(etag)};
+				if(!value.empty()) {
+					set("If-None-Match",value);
+				}
+
+			}
+
+			long long offset = 0;
+
+			if(resume && stat(partial.c_str(),&st) == 0 && st.st_size > 0) {
+
+				std::string value{load(validator)};
+				if(!value.empty()) {
+					offset = (long long) st.st_size;
+					set("Range",std::string{"bytes="} + std::to_string(offset) + "-");
+					set("If-Range",value);
+				}
+
+			}
+
+			std::unique_ptr<Client> client;
+			try {
+				client = connect();
+			} catch(...) {
+				for(const std::string &name : added) {
+					unset(name.c_str());
+				}
+				throw;
+			}
+
+			for(const std::string &name : added) {
+				unset(name.c_str());
+			}
+
+			if(client->status == 304) {
+
+				// Not modified, a partial download is from another version.
+				Logger::String{"Server response was '",client->status," ",client->text,"' keeping '",filename,"'"}.info("civetweb");
+				::remove(partial.c_str());
+				::remove(validator.c_str());
+				return false;
+
+			}
+
+			if(client->status == 416 && offset) {
+
+				// The partial file doesn't match the server one, start again.
+				Logger::String{"Server response was '",client->status," ",client->text,"' removing '",partial,"'"}.warning("civetweb");
+				client.reset();
+				::remove(partial.c_str());
+				::remove(validator.c_str());
+#ifndef _WIN32
+				lock.reset();
+#endif // !_WIN32
+				return save(filename,progress,replace);
+
+			}
+
+			if(client->status == 206) {
+
+				// Resumed, check the range.
+				const char *range = client->header("Content-Range");
+				std::string expected{"bytes "};
+				expected += std::to_string(offset);
+				expected += "-";
+
+				if(!offset || !range || strncasecmp(range,expected.c_str(),expected.size())) {
+					::remove(partial.c_str());
+					::remove(validator.c_str());
+					throw runtime_error(Logger::String{"Unexpected range '",(range ? range : ""),"' from server"});
+				}
+
+			} else if(client->status >= 200 && client->status <= 299) {
+
+				offset = 0;
+
+			} else {
+
+				Logger::String{"Server response was '",client->status," ",client->text,"'"}.info("civetweb");
+				throw HTTP::Exception(client->status, client->text.c_str());
+
+			}
+
+			Logger::String{
+				"Server response was '",client->status," ",client->text,"' ",
+				(offset ? "resuming '" : "updating '"),filename,"'"
+			}.info("civetweb");
+
+			// A decoded body can't be resumed, the ranges are on the encoded one.
+			if(client->decoding()) {
+				resume = false;
+				::remove(validator.c_str());
+			}
+
+			// Keep the validator before writing, it allows resuming an interrupted download.
+			if(resume && client->status != 206) {
+				const char *value = client->header("ETag");
+				if(value && !strncmp(value,"W/",2)) {
+					// Weak tags can't be used on If-Range.
+					value = nullptr;
+				}
+				if(!value) {
+					value = client->header("Last-Modified");
+				}
+				store(validator,value);
+			}
+
+#ifndef _WIN32
+			// Large files from servers accepting ranges are downloaded in parallel segments.
+			unsigned int count = 0;
+			if(client->status == 200 && client->length > 0) {
+				const char *ranges = client->header("Accept-Ranges");
+				if(ranges && strstr(ranges,"bytes")) {
+					long long minimum = std::max((unsigned int) Config::Value<unsigned int>("http-client","min-segment",8388608),1U);
+					count = (unsigned int) std::min((long long) ((unsigned int) Config::Value<unsigned int>("http-client","segments",4)), client->length / minimum);
+				}
+			}
+
+			if(count > 1) {
+
+				int fd = ::open(partial.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+				if(fd < 0) {
+					throw system_error(errno,system_category(),partial);
+				}
+
+				try {
+
+					if(posix_fallocate(fd,0,(off_t) client->length) && ftruncate(fd,(off_t) client->length)) {
+						throw system_error(errno,system_category(),partial);
+					}
+
+					segments(*client,fd,count,progress);
+
+					if(::close(fd)) {
+						fd = -1;
+						throw system_error(errno,system_category(),partial);
+					}
+
+				} catch(...) {
+
+					// The segments can't be resumed.
+					if(fd >= 0) {
+						::close(fd);
+					}
+					::remove(partial.c_str());
+					::remove(validator.c_str());
+					throw;
+
+				}
+
+			} else
+#endif // !_WIN32
+			{
+				FILE *file = fopen(partial.c_str(),(offset ? "ab" : "wb"));
+				if(!file) {
+					throw system_error(errno,system_category(),partial);
+				}
+
+				try {
+
+					// The progress is on the bytes received from the server, the decoded ones are written.
+					double total = (double) (client->wire.length > 0 ? client->wire.length + offset : 0);
+					char buffer[16384];
+					size_t szRead;
+
+					progress((double) offset, total);
+
+					// Chunked and close delimited bodies end when read() returns 0.
+					while((szRead = client->read((void *) buffer, sizeof(buffer))) > 0) {
+
+						if(fwrite(buffer,1,szRead,file) != szRead) {
+							throw system_error(errno,system_category(),partial);
+						}
+
+						if(!progress((double) (offset + client->wire.received), total)) {
+							throw system_error(ECANCELED,system_category());
+						}
+
+					}
+
+					if(fclose(file)) {
+						file = nullptr;
+						throw system_error(errno,system_category(),partial);
+					}
+					file = nullptr;
+
+					if(client->decoding()) {
+						Logger::String{"Received ",client->wire.received," bytes, decoded to ",client->decoded}.trace("civetweb");
+					}
+
+				} catch(...) {
+
+					if(file) {
+						fclose(file);
+					}
+
+					if(!(resume && stat(validator.c_str(),&st) == 0)) {
+						// Can't be resumed.
+						::remove(partial.c_str());
+					}
+
+					throw;
+
+				}
+
+			}
+
+			// Complete, replace the file.
+			if(!replace) {
+				std::string backup{std::string{filename} + ".bak"};
+				::remove(backup.c_str());
+				::rename(filename,backup.c_str());
+			}
+
+#ifdef _WIN32
+			::remove(filename);
+#endif // _WIN32
+
+			if(::rename(partial.c_str(),filename)) {
+				throw system_error(errno,system_category(),filename);
+			}
+
+			::remove(validator.c_str());
+
+			{
+				const char *value = client->header("ETag");
+				store(etag,(Config::Value<bool>("http-client","conditional",true) ? value : nullptr));
+			}
+
+			// Set filetimestamp
+			utimbuf ub;
+			ub.actime = time(0);
+			ub.modtime = 0;
+
+			{
+				const char *modified = client->header("Last-Modified");
+				if(modified) {
+					ub.modtime = (time_t) HTTP::TimeStamp(modified);
+				}
+			}
+
+			if(ub.modtime == 0) {
+
+				cerr << "civetweb\tNo cache information in the response header" << endl;
+
+			} else if(utime(filename,&ub) == -1) {
+
+				cerr << "civetweb\tError '" << strerror(errno) << "' setting file timestamp" << endl;
+
+			} else {
+
+				cout << "civetweb\t'" << filename << "' time set to " << TimeStamp(ub.modtime) << endl;
+
+			}
+
+			return true;
+
+		}
+
+	 }
+
+ }
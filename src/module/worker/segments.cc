@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the segmented download.
+  *
+  * The first range is read from the response already received, the
+  * others are requested on new sessions by one thread each; all of them
+  * write to the preallocated file with pwrite(). The progress callback
+  * is only called from the worker thread.
+  *
+  */
+
+ #include <config.h>
+ #include <private/module.h>
+ #include <udjat/tools/logger.h>
+ #include <thread>
+ #include <mutex>
+ #include <condition_variable>
+ #include <atomic>
+ #include <vector>
+ #include <exception>
+ #include <chrono>
+
+#ifndef _WIN32
+
+ #include <unistd.h>
+
+ namespace Udjat {
+
+	 namespace CivetWeb {
+
+		/// @brief Write at offset.
+		static void write_at(int fd, const char *data, size_t length, long long offset) {
+
+			while(length) {
+
+				ssize_t bytes = pwrite(fd,data,length,(off_t) offset);
+
+				if(bytes < 0) {
+					if(errno == EINTR) {
+						continue;
+					}
+					throw system_error(errno,system_category(),"Cant write segment");
+				}
+
+				data += bytes;
+				length -= (size_t) bytes;
+				offset += bytes;
+
+			}
+
+		}
+
+		void Worker::segments(Client &client, int fd, unsigned int count, const std::function<bool(double current, double total)> &progress) {
+
+			const long long length = client.length;
+			const long long size = length / count;
+
+			URL::Components components = url().ComponentsFactory();
+
+			// Requests are built here, the worker isn't thread safe.
+			std::vector<std::string> requests;
+			{
+				// Only the same version of the file, the server sends 200 if it has changed.
+				const char *validator = client.header("ETag");
+				if(validator && !strncmp(validator,"W/",2)) {
+					validator = nullptr;
+				}
+				if(!validator) {
+					validator = client.header("Last-Modified");
+				}
+
+				if(validator) {
+					request("If-Range") = validator;
+				}
+
+				for(unsigned int segment = 1; segment < count; segment++) {
+					long long from = segment * size;
+					long long to = (segment == (count-1) ? length : from + size) - 1;
+					request("Range") = std::string{"bytes="} + std::to_string(from) + "-" + std::to_string(to);
+					requests.push_back(build(components));
+				}
+
+				unset("Range");
+				unset("If-Range");
+			}
+
+			Logger::String{"Downloading ",length," bytes in ",count," segments"}.trace("civetweb");
+
+			std::atomic<long long> loaded{0};
+			std::atomic<bool> cancel{false};
+
+			struct {
+				std::mutex guard;
+				std::condition_variable cond;
+				unsigned int running = 0;
+				std::exception_ptr error;
+			} state;
+
+			std::vector<std::thread> threads;
+
+			auto join = [&threads]() {
+				for(std::thread &thread : threads) {
+					thread.join();
+				}
+				threads.clear();
+			};
+
+			try {
+
+				for(unsigned int segment = 1; segment < count; segment++) {
+
+					{
+						std::lock_guard<std::mutex> lock(state.guard);
+						state.running++;
+					}
+
+					threads.emplace_back([&,segment](){
+
+						try {
+
+							long long offset = segment * size;
+							long long to = (segment == (count-1) ? length : offset + size);
+
+							Client response{
+								components.scheme.c_str(),
+								components.hostname.c_str(),
+								components.portnumber(),
+								requests[segment-1]
+							};
+
+							std::string expected{"bytes "};
+							expected += std::to_string(offset);
+							expected += "-";
+
+							const char *range = response.header("Content-Range");
+							if(response.status != 206 || !range || strncasecmp(range,expected.c_str(),expected.size())) {
+								throw runtime_error(Logger::String{"Unexpected response '",response.status," ",response.text,"' for segment ",segment});
+							}
+
+							char buffer[65536];
+							size_t bytes;
+							while(!cancel && (bytes = response.read(buffer,sizeof(buffer))) > 0) {
+								write_at(fd,buffer,bytes,offset);
+								offset += bytes;
+								loaded += bytes;
+							}
+
+							if(!cancel && offset != to) {
+								throw runtime_error(Logger::String{"Segment ",segment," is incomplete"});
+							}
+
+						} catch(...) {
+
+							std::lock_guard<std::mutex> lock(state.guard);
+							if(!state.error) {
+								state.error = std::current_exception();
+							}
+							cancel = true;
+
+						}
+
+						std::lock_guard<std::mutex> lock(state.guard);
+						state.running--;
+						state.cond.notify_all();
+
+					});
+
+				}
+
+				// First segment, from the current response.
+				{
+					char buffer[65536];
+					long long offset = 0;
+
+					while(offset < size && !cancel) {
+
+						size_t bytes = client.read(buffer,(size_t) std::min((long long) sizeof(buffer),size - offset));
+						if(!bytes) {
+							throw system_error(ENOTCONN,system_category(),"Connection closed while downloading file");
+						}
+
+						write_at(fd,buffer,bytes,offset);
+						offset += bytes;
+						loaded += bytes;
+
+						if(!progress((double) loaded, (double) length)) {
+							throw system_error(ECANCELED,system_category());
+						}
+
+					}
+				}
+
+				// Wait for the other ones.
+				std::unique_lock<std::mutex> lock(state.guard);
+				while(state.running) {
+
+					state.cond.wait_for(lock,std::chrono::milliseconds(100));
+
+					lock.unlock();
+					if(!progress((double) loaded, (double) length)) {
+						throw system_error(ECANCELED,system_category());
+					}
+					lock.lock();
+
+				}
+
+			} catch(...) {
+
+				cancel = true;
+				join();
+				throw;
+
+			}
+
+			join();
+
+			if(state.error) {
+				std::rethrow_exception(state.error);
+			}
+
+			progress((double) length, (double) length);
+
+		}
+
+	 }
+
+ }
+
+#endif // !_WIN32
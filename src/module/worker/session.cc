@@ -0,0 +1,506 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client connection to a HTTP server.
+  *
+  * Civetweb client connections can't send a second request, so the
+  * worker keeps its own non blocking sockets (with OpenSSL for https).
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/client.h>
+ #include <private/resolver.h>
+ #include <private/tlscache.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+ #include <system_error>
+ #include <stdexcept>
+ #include <cstring>
+ #include <cerrno>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+
+	#define poll WSAPoll
+	#define MSG_NOSIGNAL 0
+
+	static inline int socket_error() noexcept {
+		return WSAGetLastError();
+	}
+
+	static inline bool pending(int error) noexcept {
+		return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+	}
+
+	static void nonblocking(SOCKET sock) {
+		u_long mode = 1;
+		ioctlsocket(sock, FIONBIO, &mode);
+	}
+
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netdb.h>
+	#include <poll.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+
+	#define INVALID_SOCKET -1
+	#define closesocket ::close
+
+	static inline int socket_error() noexcept {
+		return errno;
+	}
+
+	static inline bool pending(int error) noexcept {
+		return error == EAGAIN || error == EWOULDBLOCK || error == EINPROGRESS || error == EINTR;
+	}
+
+	static void nonblocking(int sock) {
+		fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+	}
+
+#endif // _WIN32
+
+#ifdef HAVE_LIBSSL
+	#include <openssl/err.h>
+	#include <openssl/x509v3.h>
+#endif // HAVE_LIBSSL
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+#ifdef HAVE_LIBSSL
+	SSL_CTX * CivetWeb::Session::context() {
+
+		static SSL_CTX *ctx = [](){
+
+			SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+			if(!ctx) {
+				throw runtime_error("Cant create TLS context");
+			}
+
+			// Civetweb client connections don't check the peer, keep it as an option.
+			SSL_CTX_set_default_verify_paths(ctx);
+			SSL_CTX_set_verify(ctx,(Config::Value<bool>("http","ssl-verify",false) ? SSL_VERIFY_PEER : SSL_VERIFY_NONE),NULL);
+
+			TLSCache::getInstance().attach(ctx);
+
+			return ctx;
+
+		}();
+
+		return ctx;
+	}
+
+	void CivetWeb::Session::expect(SSL *ssl, const char *hostname) {
+
+		// With 'http/ssl-verify' the certificate must be for this host, not only from a trusted CA.
+		if(X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl),hostname) == 1) {
+			// IP address, no SNI.
+			return;
+		}
+
+		ERR_clear_error();
+		SSL_set_tlsext_host_name(ssl,hostname);
+		if(SSL_set1_host(ssl,hostname) != 1) {
+			throw runtime_error(Logger::String{"Cant set the expected TLS peer name '",hostname,"'"});
+		}
+
+	}
+
+	static std::string ssl_error() {
+		char text[256];
+		ERR_error_string_n(ERR_get_error(),text,sizeof(text));
+		return text;
+	}
+#endif // HAVE_LIBSSL
+
+	CivetWeb::Session::Session(const char *scheme, const char *hostname, unsigned int port)
+		: key{std::string{scheme} + "://" + hostname + ":" + std::to_string(port)},
+			timeout{milliseconds(Config::Value<time_t>("http","timeout",10) * 1000)} {
+
+		bool tls = (strcasecmp(scheme,"https") == 0);
+
+#ifndef HAVE_LIBSSL
+		if(tls) {
+			throw system_error(ENOTSUP,system_category(),"Built without TLS support");
+		}
+#endif // HAVE_LIBSSL
+
+		auto started = steady_clock::now();
+
+		auto addresses = Resolver::getInstance().resolve(hostname,port);
+
+		auto resolved = steady_clock::now();
+		timing.dns = duration_cast<microseconds>(resolved - started);
+
+		int error = ENOTCONN;
+
+		for(auto address = addresses->begin(); address != addresses->end() && sock == INVALID_SOCKET; address++) {
+
+			sock = socket(address->family, address->socktype, address->protocol);
+			if(sock == INVALID_SOCKET) {
+				error = socket_error();
+				continue;
+			}
+
+			nonblocking(sock);
+
+			if(::connect(sock, (const struct sockaddr *) &address->addr, address->length) != 0) {
+
+				error = socket_error();
+				if(pending(error)) {
+
+					try {
+
+						wait(true);
+
+						int value = 0;
+						socklen_t length = sizeof(value);
+						getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *) &value, &length);
+						error = value;
+
+					} catch(const system_error &e) {
+
+						error = e.code().value();
+
+					}
+
+				}
+
+				if(error) {
+					closesocket(sock);
+					sock = INVALID_SOCKET;
+					continue;
+				}
+
+			}
+
+			int flag = 1;
+			setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(flag));
+
+		}
+
+		if(sock == INVALID_SOCKET) {
+			// The addresses may be outdated, resolve again on the next attempt.
+			Resolver::getInstance().forget(hostname,port);
+		}
+
+		if(sock == INVALID_SOCKET) {
+			throw system_error(error,system_category(),hostname);
+		}
+
+		auto connected = steady_clock::now();
+		timing.connect = duration_cast<microseconds>(connected - resolved);
+
+#ifdef HAVE_LIBSSL
+		if(tls) {
+
+			try {
+
+				ssl = SSL_new(context());
+				if(!ssl) {
+					throw runtime_error(ssl_error());
+				}
+
+				SSL_set_fd(ssl,(int) sock);
+				expect(ssl,hostname);
+				TLSCache::getInstance().prepare(ssl,key);
+
+				int rc;
+				while((ERR_clear_error(), rc = SSL_connect(ssl)) != 1) {
+
+					switch(SSL_get_error(ssl,rc)) {
+					case SSL_ERROR_WANT_READ:
+						wait(false);
+						break;
+
+					case SSL_ERROR_WANT_WRITE:
+						wait(true);
+						break;
+
+					default:
+						TLSCache::getInstance().forget(key);
+						throw runtime_error(Logger::String{"TLS handshake with '",hostname,"' has failed: ",ssl_error()});
+					}
+
+				}
+
+				TLSCache::getInstance().handshake(ssl);
+				timing.tls = duration_cast<microseconds>(steady_clock::now() - connected);
+
+			} catch(...) {
+
+				if(ssl) {
+					SSL_free(ssl);
+					ssl = nullptr;
+				}
+				closesocket(sock);
+				sock = INVALID_SOCKET;
+				throw;
+
+			}
+
+		}
+#endif // HAVE_LIBSSL
+
+	}
+
+	CivetWeb::Session::~Session() {
+
+#ifdef HAVE_LIBSSL
+		if(ssl) {
+			SSL_shutdown(ssl);
+			SSL_free(ssl);
+		}
+#endif // HAVE_LIBSSL
+
+		if(sock != INVALID_SOCKET) {
+			closesocket(sock);
+		}
+
+	}
+
+	void CivetWeb::Session::wait(bool output) {
+
+		struct pollfd pfd;
+		memset(&pfd,0,sizeof(pfd));
+		pfd.fd = sock;
+		pfd.events = (output ? POLLOUT : POLLIN);
+
+		int rc;
+		do {
+			rc = poll(&pfd,1,(int) timeout.count());
+		} while(rc < 0 && socket_error() == EINTR);
+
+		if(rc == 0) {
+			throw system_error(ETIMEDOUT,system_category(),key);
+		} else if(rc < 0) {
+			throw system_error(socket_error(),system_category(),key);
+		}
+
+	}
+
+	bool CivetWeb::Session::alive() noexcept {
+
+		if(offset < length || sock == INVALID_SOCKET) {
+			return false;
+		}
+
+		struct pollfd pfd;
+		memset(&pfd,0,sizeof(pfd));
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+
+		if(poll(&pfd,1,0) == 0) {
+			return true;
+		}
+
+		// Readable, the server has closed it or sent something unexpected.
+#ifdef HAVE_LIBSSL
+		if(ssl) {
+			// TLS 1.3 session tickets can arrive after the response.
+			char byte;
+			int rc = SSL_peek(ssl,&byte,1);
+			return rc <= 0 && SSL_get_error(ssl,rc) == SSL_ERROR_WANT_READ;
+		}
+#endif // HAVE_LIBSSL
+
+		return false;
+
+	}
+
+	void CivetWeb::Session::write(const void *data, size_t length) {
+
+		const char *ptr = (const char *) data;
+
+		while(length) {
+
+#ifdef HAVE_LIBSSL
+			if(ssl) {
+
+				ERR_clear_error();
+				int rc = SSL_write(ssl,ptr,(int) length);
+				if(rc > 0) {
+					ptr += rc;
+					length -= rc;
+					continue;
+				}
+
+				switch(SSL_get_error(ssl,rc)) {
+				case SSL_ERROR_WANT_READ:
+					wait(false);
+					break;
+
+				case SSL_ERROR_WANT_WRITE:
+					wait(true);
+					break;
+
+				default:
+					throw runtime_error(Logger::String{key,": ",ssl_error()});
+				}
+
+				continue;
+			}
+#endif // HAVE_LIBSSL
+
+			auto rc = ::send(sock,ptr,length,MSG_NOSIGNAL);
+			if(rc > 0) {
+				ptr += rc;
+				length -= rc;
+			} else if(pending(socket_error())) {
+				wait(true);
+			} else {
+				throw system_error(socket_error(),system_category(),key);
+			}
+
+		}
+
+	}
+
+	size_t CivetWeb::Session::recv(void *data, size_t length) {
+
+		for(;;) {
+
+#ifdef HAVE_LIBSSL
+			if(ssl) {
+
+				ERR_clear_error();
+				int rc = SSL_read(ssl,data,(int) length);
+				if(rc > 0) {
+					return (size_t) rc;
+				}
+
+				switch(SSL_get_error(ssl,rc)) {
+				case SSL_ERROR_WANT_READ:
+					wait(false);
+					break;
+
+				case SSL_ERROR_WANT_WRITE:
+					wait(true);
+					break;
+
+				case SSL_ERROR_ZERO_RETURN:
+					return 0;
+
+				case SSL_ERROR_SYSCALL:
+					if(ERR_peek_error()) {
+						throw runtime_error(Logger::String{key,": ",ssl_error()});
+					}
+					if(rc == 0) {
+						// Closed without close_notify.
+						return 0;
+					}
+					throw system_error(socket_error(),system_category(),key);
+
+				default:
+					throw runtime_error(Logger::String{key,": ",ssl_error()});
+				}
+
+				continue;
+			}
+#endif // HAVE_LIBSSL
+
+			auto rc = ::recv(sock,(char *) data,length,0);
+			if(rc >= 0) {
+				return (size_t) rc;
+			} else if(pending(socket_error())) {
+				wait(false);
+			} else {
+				throw system_error(socket_error(),system_category(),key);
+			}
+
+		}
+
+	}
+
+	size_t CivetWeb::Session::read(void *data, size_t length) {
+
+		if(offset < this->length) {
+			size_t bytes = std::min(length,this->length - offset);
+			memcpy(data,buffer+offset,bytes);
+			offset += bytes;
+			return bytes;
+		}
+
+		// Large reads go straight to the caller.
+		if(length >= sizeof(buffer)) {
+			return recv(data,length);
+		}
+
+		offset = 0;
+		this->length = recv(buffer,sizeof(buffer));
+		if(!this->length) {
+			return 0;
+		}
+
+		size_t bytes = std::min(length,this->length);
+		memcpy(data,buffer,bytes);
+		offset = bytes;
+		return bytes;
+
+	}
+
+	bool CivetWeb::Session::getline(std::string &line) {
+
+		line.clear();
+
+		for(;;) {
+
+			if(offset >= length) {
+				offset = 0;
+				length = recv(buffer,sizeof(buffer));
+				if(!length) {
+					return false;
+				}
+			}
+
+			const char *from = buffer + offset;
+			const char *eol = (const char *) memchr(from,'\n',length - offset);
+
+			if(eol) {
+				line.append(from,eol - from);
+				offset += (eol - from) + 1;
+				if(!line.empty() && line.back() == '\r') {
+					line.pop_back();
+				}
+				return true;
+			}
+
+			line.append(from,length - offset);
+			offset = length;
+
+			if(line.size() > 16384) {
+				throw runtime_error(Logger::String{key,": Response header is too long"});
+			}
+
+		}
+
+	}
+
+ }
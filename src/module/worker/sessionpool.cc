@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the keep-alive session pool.
+  *
+  * Sessions are returned to the pool only after the response body was
+  * fully read; before reuse they are checked for a server side close.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/client.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	CivetWeb::SessionPool::SessionPool() {
+	}
+
+	CivetWeb::SessionPool::~SessionPool() {
+		clear();
+	}
+
+	CivetWeb::SessionPool & CivetWeb::SessionPool::getInstance() {
+		static SessionPool instance;
+		return instance;
+	}
+
+	void CivetWeb::SessionPool::setup() {
+
+		lock_guard<mutex> lock(guard);
+
+		limits.enabled = Config::Value<bool>("http-client","keep-alive",true);
+		limits.max_idle = Config::Value<unsigned int>("http-client","max-idle",32);
+		limits.max_host = Config::Value<unsigned int>("http-client","max-idle-per-host",4);
+		limits.max_requests = Config::Value<unsigned int>("http-client","max-requests",100);
+		limits.timeout = seconds(Config::Value<unsigned int>("http-client","idle-timeout",30));
+
+	}
+
+	void CivetWeb::SessionPool::expire(const steady_clock::time_point &now) {
+
+		for(auto it = sessions.begin(); it != sessions.end();) {
+
+			auto &list = it->second;
+
+			// Oldest first.
+			while(!list.empty() && (list.front()->idle + limits.timeout) < now) {
+				delete list.front();
+				list.pop_front();
+				count--;
+				counters.expired++;
+			}
+
+			if(list.empty()) {
+				it = sessions.erase(it);
+			} else {
+				it++;
+			}
+
+		}
+
+	}
+
+	std::unique_ptr<CivetWeb::Session> CivetWeb::SessionPool::get(const char *scheme, const char *hostname, unsigned int port, bool &reused) {
+
+		reused = false;
+
+		{
+			string key{std::string{scheme} + "://" + hostname + ":" + std::to_string(port)};
+
+			lock_guard<mutex> lock(guard);
+
+			expire(steady_clock::now());
+
+			auto it = sessions.find(key);
+			if(it != sessions.end()) {
+
+				// Most recently used first, it's the one less likely to be closed by the server.
+				while(!it->second.empty()) {
+
+					std::unique_ptr<Session> session{it->second.back()};
+					it->second.pop_back();
+					count--;
+
+					if(session->alive()) {
+						counters.reused++;
+						reused = true;
+						return session;
+					}
+
+					counters.stale++;
+
+				}
+
+				sessions.erase(it);
+
+			}
+
+		}
+
+		counters.created++;
+		return make_unique<Session>(scheme,hostname,port);
+
+	}
+
+	void CivetWeb::SessionPool::put(std::unique_ptr<Session> session) noexcept {
+
+		if(!session) {
+			return;
+		}
+
+		if(!limits.enabled || session->requests >= limits.max_requests) {
+			counters.discarded++;
+			return;
+		}
+
+		try {
+
+			lock_guard<mutex> lock(guard);
+
+			auto now = steady_clock::now();
+			expire(now);
+
+			auto &list = sessions[session->key];
+
+			if(list.size() >= limits.max_host && !list.empty()) {
+				delete list.front();
+				list.pop_front();
+				count--;
+				counters.discarded++;
+			}
+
+			if(count >= limits.max_idle || !limits.max_host) {
+				counters.discarded++;
+				if(list.empty()) {
+					sessions.erase(session->key);
+				}
+				return;
+			}
+
+			session->idle = now;
+			list.push_back(session.release());
+			count++;
+
+		} catch(...) {
+
+			counters.discarded++;
+
+		}
+
+	}
+
+	void CivetWeb::SessionPool::clear() noexcept {
+
+		lock_guard<mutex> lock(guard);
+
+		for(auto &it : sessions) {
+			for(Session *session : it.second) {
+				delete session;
+			}
+		}
+
+		sessions.clear();
+		count = 0;
+
+	}
+
+	void CivetWeb::SessionPool::get(Udjat::Value &value) {
+
+		{
+			lock_guard<mutex> lock(guard);
+			value["idle"] = (unsigned int) count;
+			value["hosts"] = (unsigned int) sessions.size();
+		}
+
+		value["created"] = (unsigned int) counters.created;
+		value["reused"] = (unsigned int) counters.reused;
+		value["expired"] = (unsigned int) counters.expired;
+		value["stale"] = (unsigned int) counters.stale;
+		value["discarded"] = (unsigned int) counters.discarded;
+
+	}
+
+ }
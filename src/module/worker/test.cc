@@ -34,69 +34,86 @@
 
 		int Worker::test(const std::function<bool(double current, double total)> &progress) noexcept {
 
+			using namespace std::chrono;
+
 			progress(0,0);
 
-			struct mg_connection *conn;
+			auto started = steady_clock::now();
+			timing = Timing{};
+
+			std::unique_ptr<Client> client;
 			try {
 
-				conn = connect();
+				client = connect();
 
 			} catch(const std::exception &e) {
 
 				error() << url() << ":" << e.what() << endl;
+				timing.total = duration_cast<microseconds>(steady_clock::now() - started);
+				headers.response.clear();
 				return ENOTCONN;
 
 			} catch(...) {
 
 				error() << url() << ": Unexpected error" << endl;
+				timing.total = duration_cast<microseconds>(steady_clock::now() - started);
+				headers.response.clear();
 				return ENOTCONN;
 
 			}
 
-			int response = -1;
-
-			const struct mg_response_info *info = mg_get_response_info(conn);
-
-			response = info->status_code;
+			int response = client->status;
 
-			if(info->content_length > 0) {
+			// The body is only timed, read it into a fixed buffer (chunked and close delimited too).
+			auto received = steady_clock::now();
+			double total = (double) (client->wire.length > 0 ? client->wire.length : 0);
 
-				progress((double) 0, (double) info->content_length);
-				char * buffer = new char [info->content_length + 1];
-				memset(buffer,0,info->content_length + 1);
+			progress(0,total);
 
-				long long loaded = 0;
+			char buffer[16384];
 
-				char buf[1024];
-				while(loaded < info->content_length && response == info->status_code) {
+			while(response == client->status) {
 
-					int szRead = mg_read(conn, buf, 1024);
+				try {
 
-					if(szRead == 0) {
-
-						response = ENOTCONN;
+					if(!client->read(buffer,sizeof(buffer))) {
+						break;
+					}
 
-					} else if(szRead < 0) {
+					if(!progress((double) client->wire.received, total)) {
+						response = ECANCELED;
+					}
 
-						response = errno;
-						break;
+				} catch(const std::system_error &e) {
 
-					} else {
+					response = e.code().value();
 
-						loaded += (size_t) szRead;
-						if(!progress((double) loaded, (double) info->content_length)) {
-							response = ECANCELED;
-						}
+				} catch(...) {
 
-					}
+					response = EIO;
 
 				}
 
-				progress((double) info->content_length, (double) info->content_length);
-
 			}
 
-			mg_close_connection(conn);
+			auto finished = steady_clock::now();
+			timing.transfer = duration_cast<microseconds>(finished - received);
+			timing.total = duration_cast<microseconds>(finished - started);
+
+			progress((double) client->wire.received, (double) client->wire.received);
+
+			if(Logger::enabled(Logger::Trace)) {
+				try {
+					Logger::String{
+						url().c_str(),": ",response,
+						" dns=",timing.dns.count(),"us connect=",timing.connect.count(),"us tls=",timing.tls.count(),
+						"us ttfb=",timing.ttfb.count(),"us transfer=",timing.transfer.count(),"us",
+						(timing.reused ? " (reused)" : "")
+					}.trace("civetweb");
+				} catch(...) {
+					// Only the trace is lost.
+				}
+			}
 
 			return response;
 		}
@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the client TLS session cache.
+  *
+  * Sessions are captured from the new session callback (TLS 1.3 tickets
+  * arrive after the handshake) and kept by server key; OpenSSL's internal
+  * store is disabled, it's keyed by session id and useless on clients.
+  *
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/tlscache.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/logger.h>
+
+ using namespace std;
+ using namespace std::chrono;
+
+ namespace Udjat {
+
+	CivetWeb::TLSCache::TLSCache() {
+#ifdef HAVE_LIBSSL
+		index = SSL_get_ex_new_index(0,(void *) "civetweb-tls-key",NULL,NULL,NULL);
+#endif // HAVE_LIBSSL
+	}
+
+	CivetWeb::TLSCache::~TLSCache() {
+		clear();
+	}
+
+	CivetWeb::TLSCache & CivetWeb::TLSCache::getInstance() {
+		static TLSCache instance;
+		return instance;
+	}
+
+	void CivetWeb::TLSCache::setup() {
+
+		lock_guard<mutex> lock(guard);
+
+		limits.enabled = Config::Value<bool>("http-client","tls-resume",true);
+		limits.max_entries = std::max((unsigned int) Config::Value<unsigned int>("http-client","tls-max-sessions",64),1U);
+
+	}
+
+#ifdef HAVE_LIBSSL
+
+	void CivetWeb::TLSCache::attach(SSL_CTX *ctx) {
+		SSL_CTX_set_session_cache_mode(ctx,SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(ctx,store);
+	}
+
+	int CivetWeb::TLSCache::store(SSL *ssl, SSL_SESSION *session) {
+
+		TLSCache &cache = getInstance();
+
+		const std::string *key = (const std::string *) SSL_get_ex_data(ssl,cache.index);
+		if(!key || !SSL_SESSION_is_resumable(session)) {
+			return 0;
+		}
+
+		lock_guard<mutex> lock(cache.guard);
+
+		if(!cache.limits.enabled) {
+			return 0;
+		}
+
+		auto it = cache.sessions.find(*key);
+		if(it == cache.sessions.end()) {
+
+			if(cache.sessions.size() >= cache.limits.max_entries) {
+
+				auto oldest = cache.sessions.begin();
+				for(auto entry = cache.sessions.begin(); entry != cache.sessions.end(); entry++) {
+					if(entry->second.stored < oldest->second.stored) {
+						oldest = entry;
+					}
+				}
+
+				SSL_SESSION_free(oldest->second.session);
+				cache.sessions.erase(oldest);
+
+			}
+
+			it = cache.sessions.emplace(*key,Entry{}).first;
+
+		} else if(it->second.session) {
+
+			SSL_SESSION_free(it->second.session);
+
+		}
+
+		it->second.session = session;
+		it->second.stored = steady_clock::now();
+		cache.counters.stored++;
+
+		// We own the session reference.
+		return 1;
+
+	}
+
+	void CivetWeb::TLSCache::prepare(SSL *ssl, const std::string &key) {
+
+		lock_guard<mutex> lock(guard);
+
+		if(!limits.enabled) {
+			return;
+		}
+
+		// The key must outlive the handshake, it's owned by the caller's connection.
+		SSL_set_ex_data(ssl,index,(void *) &key);
+
+		auto it = sessions.find(key);
+		if(it == sessions.end()) {
+			return;
+		}
+
+		if(!SSL_SESSION_is_resumable(it->second.session)) {
+			SSL_SESSION_free(it->second.session);
+			sessions.erase(it);
+			return;
+		}
+
+		if(SSL_set_session(ssl,it->second.session) == 1) {
+			counters.offered++;
+		}
+
+	}
+
+	void CivetWeb::TLSCache::handshake(SSL *ssl) noexcept {
+		if(SSL_session_reused(ssl)) {
+			counters.resumed++;
+		} else {
+			counters.full++;
+		}
+	}
+
+#endif // HAVE_LIBSSL
+
+	void CivetWeb::TLSCache::forget(const std::string &key) noexcept {
+#ifdef HAVE_LIBSSL
+		lock_guard<mutex> lock(guard);
+		auto it = sessions.find(key);
+		if(it != sessions.end()) {
+			SSL_SESSION_free(it->second.session);
+			sessions.erase(it);
+		}
+#endif // HAVE_LIBSSL
+	}
+
+	void CivetWeb::TLSCache::clear() noexcept {
+#ifdef HAVE_LIBSSL
+		lock_guard<mutex> lock(guard);
+		for(auto &it : sessions) {
+			SSL_SESSION_free(it.second.session);
+		}
+		sessions.clear();
+#endif // HAVE_LIBSSL
+	}
+
+	void CivetWeb::TLSCache::get(Udjat::Value &value) {
+
+		uint64_t total = counters.full + counters.resumed;
+
+		value["full-handshakes"] = (double) counters.full;
+		value["resumed-handshakes"] = (double) counters.resumed;
+		value["offered"] = (double) counters.offered;
+		value["stored"] = (double) counters.stored;
+		value["resume-rate"] = (total ? ((double) counters.resumed) / ((double) total) : 0.0);
+
+		lock_guard<mutex> lock(guard);
+		value["enabled"] = limits.enabled;
+
+#ifdef HAVE_LIBSSL
+		value["sessions"] = (unsigned int) sessions.size();
+#endif // HAVE_LIBSSL
+
+	}
+
+ }
@@ -36,8 +36,6 @@
 
 		Worker::Worker(const char *url, const HTTP::Method method, const char *payload) : Udjat::Protocol::Worker(url,method,payload) {
 
-			request("Connection") = "close";
-
 			{
 #ifdef _WIN32
 				string useragent{"civetweb/" CIVETWEB_VERSION " (windows) " UDJAT_PRODUCT_NAME "/" UDJAT_VERSION " (" };
@@ -58,11 +56,14 @@
 
 		}
 
-		struct mg_connection * Worker::connect() {
+		std::string Worker::build(const URL::Components &components) {
 
-			URL::Components components = url().ComponentsFactory();
 			request("Host") = components.hostname;
 
+			if(!SessionPool::getInstance().enabled()) {
+				request("Connection") = "close";
+			}
+
 			Config::for_each(
 				(components.scheme + "-default-headers").c_str(),
 				[this](const char *key, const char *value) {
@@ -71,55 +72,85 @@
 				}
 			);
 
-			string hdr;
+			const char *payload = get_payload();
+			if(payload && *payload) {
+				request("Content-Length") = std::to_string(strlen(payload));
+			}
+
+			string text{std::to_string(method())};
+			text += " ";
+			text += (components.path.empty() ? "/" : components.path.c_str());
+			text += " HTTP/1.1\r\n";
+
 			for(Protocol::Header &header : headers.request) {
-				hdr += header.name();
-				hdr += ":";
-				hdr += header.value();
-				hdr += "\r\n";
+				text += header.name();
+				text += ":";
+				text += header.value();
+				text += "\r\n";
+			}
+
+			text += "\r\n";
+
+			if(payload) {
+				text += payload;
 			}
 
-			char error_buffer[1024] = {0};
-			struct mg_connection *conn = NULL;
+			return text;
 
-			conn = mg_connect_client(
-				components.hostname.c_str(),
-				components.portnumber(),
-				strcasecmp(components.scheme.c_str(),"https") == 0,
-				error_buffer,
-				sizeof(error_buffer)
+		}
+
+		std::unique_ptr<Client> Worker::connect() {
+
+			URL::Components components = url().ComponentsFactory();
+
+			// Compressed transfer is opt-in, and not on ranges (they are on the encoded content).
+			bool compressed = (
+				Config::Value<bool>("http-client","compression",false)
+				&& *Decoder::accepted()
+				&& !requested("Accept-Encoding")
+				&& !requested("Range")
 			);
 
-			if(!conn) {
-				throw runtime_error(error_buffer);
+			if(compressed) {
+				request("Accept-Encoding") = Decoder::accepted();
 			}
 
-			mg_set_user_connection_data(conn,this);
+			std::string text{build(components)};
 
-			mg_printf(conn,"%s %s HTTP/1.0\r\n%s\r\n%s",
-				std::to_string(method()),
-				(components.path.empty() ? "/" : components.path.c_str()),
-				hdr.c_str(),
-				get_payload()
-			);
+			if(compressed) {
+				unset("Accept-Encoding");
+			}
 
-			int ret = mg_get_response(
-							conn,
-							error_buffer,
-							sizeof(error_buffer),
-							(Config::Value<time_t>("http","timeout",10) * 1000)
-					);
-
-			if (ret < 0) {
-				mg_close_connection(conn);
-				conn = NULL;
-				throw runtime_error(error_buffer);
+			std::unique_ptr<Client> client{
+				new Client(
+					components.scheme.c_str(),
+					components.hostname.c_str(),
+					components.portnumber(),
+					text,
+					strcasecmp(std::to_string(method()),"HEAD") == 0
+				)
+			};
+
+			if(compressed) {
+				client->decode(client->header("Content-Encoding"));
 			}
 
-			return conn;
+			replace(client->headers);
+			timing = client->timing;
+
+			return client;
 
 		}
 
+		void Worker::replace(const std::list<std::pair<std::string,std::string>> &response) {
+			headers.response.clear();
+			for(const auto &header : response) {
+				headers.response.emplace_back(header.first.c_str());
+				Protocol::Header &value = headers.response.back();
+				value = header.second;
+			}
+		}
+
 		Protocol::Header & Header::assign(const Udjat::TimeStamp &value) {
 			std::string::assign(HTTP::TimeStamp((time_t) value).to_string());
 			return *this;
@@ -136,115 +167,51 @@
 			return headers.request.back();
 		}
 
-		const Protocol::Header & Worker::response(const char *name) {
-
-			auto it = std::find(headers.response.begin(),headers.response.end(),name);
-			if(it != headers.response.end()) {
-				return *it;
+		const char * Worker::requested(const char *name) const noexcept {
+			auto it = std::find(headers.request.begin(),headers.request.end(),name);
+			if(it != headers.request.end() && !it->empty()) {
+				return it->c_str();
 			}
-
-			headers.response.emplace_back(name);
-			return headers.response.back();
+			return nullptr;
 		}
 
-		bool Worker::save(const char *filename, const std::function<bool(double current, double total)> &progress, bool replace) {
-
-			progress(0,0);
-
-			struct mg_connection *conn = connect();
-
-			bool status = false;
-
-			try {
-
-				const struct mg_response_info *info = mg_get_response_info(conn);
-
-				if(info->status_code == 304) {
-
-					// Not modified.
-					cout << "civetweb\tServer response was '" << info->status_code << " " << info->status_text
-							<< "' keeping '" << filename << "'" << endl;
-					status = false;
-
-				} else if(info->status_code >= 200 && info->status_code <= 299) {
-
-					cout << "civetweb\tServer response was '" << info->status_code << " " << info->status_text
-							<< "' updating '" << filename << "'" << endl;
+		bool Worker::credentials() const {
 
-					File::Temporary response{filename};
-					{
-						long long loaded = 0;
-						char buffer[4096];
-
-						while(loaded < info->content_length) {
-
-							int szRead = mg_read(conn, (void *) buffer, 4096);
-
-							if(szRead == 0) {
-								throw system_error(ENOTCONN,system_category(),"Connection closed while downloading file");
-							} else if(szRead < 0) {
-								throw runtime_error("Download error");
-							} else {
-								loaded += (size_t) szRead;
-								response.write((void *) buffer, szRead);
-								if(!progress((double) loaded, (double) info->content_length)) {
-									throw system_error(ECANCELED,system_category());
-								}
-							}
-
-						}
-					}
-					status = true;
-
-					response.save(filename,replace);
-
-					// Set filetimestamp
-					utimbuf ub;
-					ub.actime = time(0);
-					ub.modtime = 0;
-
-					for(int header = 0; header < info->num_headers; header++) {
-
-						debug(info->http_headers[header].name,"= '",info->http_headers[header].value,"'");
-
-						if(!strcasecmp(info->http_headers[header].name,"Last-Modified")) {
-							ub.modtime = (time_t) HTTP::TimeStamp(info->http_headers[header].value);
-						}
-
-					}
-
-					if(ub.modtime == 0) {
-
-						cerr << "civetweb\tNo cache information in the response header" << endl;
-
-					} else if(utime(filename,&ub) == -1) {
-
-						cerr << "civetweb\tError '" << strerror(errno) << "' setting file timestamp" << endl;
-
-					} else {
-
-						cout << "civetweb\t'" << filename << "' time set to " << TimeStamp(ub.modtime) << endl;
+			if(requested("Authorization") || requested("Cookie")) {
+				return true;
+			}
 
+			bool found = false;
+			Config::for_each(
+				(url().ComponentsFactory().scheme + "-default-headers").c_str(),
+				[&found](const char *key, const char *) {
+					if(!(strcasecmp(key,"Authorization") && strcasecmp(key,"Cookie"))) {
+						found = true;
 					}
-
-				} else {
-
-					cout << "civetweb\tServer response was '" << info->status_code << " " << info->status_text << "'" << endl;
-
-					throw HTTP::Exception(info->status_code, info->status_text);
-
+					return true;
 				}
+			);
 
-			} catch(...) {
+			return found;
 
-				mg_close_connection(conn);
-				throw;
+		}
+
+		void Worker::unset(const char *name) noexcept {
+			auto it = std::find(headers.request.begin(),headers.request.end(),name);
+			if(it != headers.request.end()) {
+				headers.request.erase(it);
 			}
+		}
 
-			mg_close_connection(conn);
+		const Protocol::Header & Worker::response(const char *name) {
 
-			return status;
+			auto it = std::find(headers.response.begin(),headers.response.end(),name);
+			if(it != headers.response.end()) {
+				return *it;
+			}
 
+			headers.response.emplace_back(name);
+			return headers.response.back();
 		}
 
 	 }
@@ -25,6 +25,12 @@
  #include <udjat/tools/logger.h>
  #include <udjat/factory.h>
  #include <udjat/tools/http/handler.h>
+ #include <udjat/tools/configuration.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/protocol.h>
+ #include <udjat/civetweb.h>
+ #include <thread>
+ #include <vector>
 
  using namespace std;
  using namespace Udjat;
@@ -87,6 +93,96 @@
 
  };
 
+ /// @brief Slow handler, for async tests.
+ class SlowHandler : public Udjat::HTTP::AsyncHandler {
+ public:
+	SlowHandler() : Udjat::HTTP::AsyncHandler{"/slow/"} {
+	}
+
+	std::function<void(Udjat::HTTP::Response &response)> prepare(const Udjat::HTTP::Request &request, const Udjat::MimeType) override {
+
+		string path{request.c_str()};
+
+		return [path](Udjat::HTTP::Response &response){
+			std::this_thread::sleep_for(std::chrono::seconds(5));
+			response["path"] = path.c_str();
+		};
+
+	}
+
+ };
+
+ /// @brief Get the 'test/batch-urls' concurrently, for client engine tests.
+ class BatchHandler : public Udjat::HTTP::AsyncHandler {
+ public:
+	BatchHandler() : Udjat::HTTP::AsyncHandler{"/batch/"} {
+	}
+
+	std::function<void(Udjat::HTTP::Response &response)> prepare(const Udjat::HTTP::Request &, const Udjat::MimeType) override {
+
+		std::vector<std::string> urls;
+		for(const String &url : String{Config::Value<string>("test","batch-urls","http://localhost:8989/,http://localhost:8989/civetweb/pool").c_str()}.split(",")) {
+			urls.emplace_back(url.c_str());
+		}
+
+		return [urls](Udjat::HTTP::Response &response){
+
+			for(const CivetWeb::Result &result : CivetWeb::get(urls)) {
+				Udjat::Value &item = response[result.url.c_str()];
+				item["status"] = result.status;
+				item["length"] = (unsigned int) result.body.size();
+				item["elapsed-ms"] = (unsigned int) result.elapsed.count();
+				if(result.error) {
+					item["error"] = result.message.c_str();
+				}
+			}
+
+		};
+
+	}
+
+ };
+
+ /// @brief Probe 'test/probe-url' with the protocol workers, for the TLS resume tests.
+ class ProbeHandler : public Udjat::HTTP::AsyncHandler {
+ public:
+	ProbeHandler() : Udjat::HTTP::AsyncHandler{"/probe/"} {
+	}
+
+	std::function<void(Udjat::HTTP::Response &response)> prepare(const Udjat::HTTP::Request &, const Udjat::MimeType) override {
+
+		string url{Config::Value<string>("test","probe-url","https://127.0.0.1:18443/").c_str()};
+		unsigned int count = Config::Value<unsigned int>("test","probe-count",20);
+
+		return [url,count](Udjat::HTTP::Response &response){
+
+			response["url"] = url.c_str();
+
+			Udjat::Value &probes = response["probes"];
+			for(unsigned int ix = 0; ix < count; ix++) {
+
+				auto worker = Udjat::Protocol::WorkerFactory(url.c_str());
+
+				Udjat::Value &item = probes[std::to_string(ix).c_str()];
+				item["rc"] = worker->test([](double, double){ return true; });
+
+				const CivetWeb::Timed *timed = dynamic_cast<const CivetWeb::Timed *>(worker.get());
+				if(timed) {
+					// In milliseconds.
+					const CivetWeb::Timing &timing = timed->timings();
+					item["tls"] = ((double) timing.tls.count()) / 1000.0;
+					item["total"] = ((double) timing.total.count()) / 1000.0;
+					item["reused"] = timing.reused;
+				}
+
+			}
+
+		};
+
+	}
+
+ };
+
  int main(int argc, char **argv) {
 
  	Logger::verbosity(9);
@@ -95,6 +191,9 @@
 
  	udjat_module_init();
  	RandomFactory rfactory;
+	SlowHandler slow;
+	BatchHandler batch;
+	ProbeHandler probe;
 
 	auto rc = Application{}.run(argc,argv,"./test.xml");
 
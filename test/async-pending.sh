@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Check the async handler flow: a slow request is answered with
+# '202 Accepted' and a Location, the location answers 202 while the
+# job is running and 200 with the response when it's done.
+#
+# Start the test program (make run) before running this script.
+#
+URL=${URL:-http://127.0.0.1:8989}
+TIMEOUT=${TIMEOUT:-30}
+
+fail() {
+	echo "$@"
+	exit 1
+}
+
+HEADERS=$(curl -s -o /dev/null -D - "${URL}/slow/check" | tr -d '\r')
+
+STATUS=$(echo "${HEADERS}" | head -1 | cut -d' ' -f2)
+[ "${STATUS}" == "202" ] || fail "Expected 202 from ${URL}/slow/check, got '${STATUS}'"
+
+LOCATION=$(echo "${HEADERS}" | grep -i '^Location:' | cut -d' ' -f2)
+[ -n "${LOCATION}" ] || fail "No Location on the 202 response"
+
+case "${LOCATION}" in
+	http*)	;;
+	*)	LOCATION="${URL}${LOCATION}" ;;
+esac
+
+echo "Pending response at ${LOCATION}"
+
+for ((i=0; i<TIMEOUT; i++)); do
+
+	STATUS=$(curl -s -o /tmp/async-pending.$$ -w '%{http_code}' "${LOCATION}")
+
+	case "${STATUS}" in
+	202)
+		sleep 1
+		;;
+
+	200)
+		grep -q 'check' /tmp/async-pending.$$ || fail "Unexpected response: $(cat /tmp/async-pending.$$)"
+		rm -f /tmp/async-pending.$$
+		echo "Response received after ${i}s"
+
+		# The response is delivered once.
+		STATUS=$(curl -s -o /dev/null -w '%{http_code}' "${LOCATION}")
+		[ "${STATUS}" == "404" ] || fail "Expected 404 for a delivered response, got '${STATUS}'"
+
+		# Not an id under the pending path.
+		STATUS=$(curl -s -o /dev/null -w '%{http_code}' "${LOCATION}/extra")
+		[ "${STATUS}" == "400" ] || fail "Expected 400 for '${LOCATION}/extra', got '${STATUS}'"
+
+		echo "Async flow is ok"
+		exit 0
+		;;
+
+	*)
+		rm -f /tmp/async-pending.$$
+		fail "Unexpected status '${STATUS}' from ${LOCATION}"
+		;;
+	esac
+
+done
+
+rm -f /tmp/async-pending.$$
+fail "No response after ${TIMEOUT}s"
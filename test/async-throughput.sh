@@ -0,0 +1,55 @@
+#!/bin/bash
+#
+# Check if the request rate and latency stay flat while slow async handlers are active.
+#
+# Start the test program (make run) before running this script; the slow
+# jobs are queued on the async pool, keep SLOW below 'http/async-max-pending'.
+#
+URL=${URL:-http://127.0.0.1:8989}
+SLOW=${SLOW:-60}
+COUNT=${COUNT:-200}
+
+fail() {
+	echo "$@"
+	exit 1
+}
+
+# Sequential plain requests, prints the rate (requests/s) and the 95th percentile latency (us).
+measure() {
+	local start=$(date +%s%N)
+	local latency=$(
+		for ((i=0; i<COUNT; i++)); do
+			curl -s -o /dev/null -w '%{time_total}\n' "${URL}/api/1.0/agent" || echo 999
+		done | sort -n | awk -v count=${COUNT} '{ value[NR] = $1 } END { printf "%d", value[int(count * 0.95)] * 1000000 }'
+	)
+	echo "$(( COUNT * 1000000000 / ($(date +%s%N) - start) )) ${latency}"
+}
+
+read BEFORE BEFORE_P95 <<< $(measure)
+
+for ((i=0; i<SLOW; i++)); do
+	curl -s -o /dev/null -w '%{http_code}\n' "${URL}/slow/${i}" > /tmp/async-throughput.$$.${i} &
+done
+
+sleep 1
+read DURING DURING_P95 <<< $(measure)
+wait
+
+ACCEPTED=$(cat /tmp/async-throughput.$$.* | grep -c '^202$')
+rm -f /tmp/async-throughput.$$.*
+
+echo "Without slow handlers: ${BEFORE} requests/s, p95 ${BEFORE_P95}us"
+echo "With ${SLOW} slow handlers: ${DURING} requests/s, p95 ${DURING_P95}us"
+
+[ "${ACCEPTED}" == "${SLOW}" ] || fail "Only ${ACCEPTED} of ${SLOW} slow requests were accepted"
+
+if [ $(( DURING * 2 )) -lt ${BEFORE} ]; then
+	fail "Throughput has dropped"
+fi
+
+# Some slack for the fast path (a few ms on loopback).
+if [ ${DURING_P95} -gt $(( BEFORE_P95 * 2 + 10000 )) ]; then
+	fail "Latency has grown"
+fi
+
+echo "Throughput is flat"
@@ -0,0 +1,89 @@
+#!/bin/bash
+#
+# Compare the full and the resumed TLS handshakes of the module client
+# against a local 'openssl s_server', the gain expected from [http-client]
+# tls-resume.
+#
+# Start the test program (make run) before running this script; its /probe/
+# handler gets [test] probe-url (default https://127.0.0.1:18443/) probe-count
+# times with the protocol workers. The server closes each connection, every
+# probe is a new handshake: the first one is full, the others are resumed.
+#
+URL=${URL:-http://127.0.0.1:8989}
+PORT=${PORT:-18443}
+TLS=${TLS:--tls1_3}
+
+fail() {
+	echo "$@"
+	exit 1
+}
+
+WORKDIR=$(mktemp -d)
+trap 'kill ${SERVER} 2>/dev/null; rm -rf ${WORKDIR}' EXIT
+
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj "/CN=localhost" \
+	-keyout ${WORKDIR}/key.pem -out ${WORKDIR}/cert.pem > /dev/null 2>&1 \
+	|| fail "Cant create the test certificate"
+
+openssl s_server -accept ${PORT} -cert ${WORKDIR}/cert.pem -key ${WORKDIR}/key.pem ${TLS} -www -quiet > /dev/null 2>&1 &
+SERVER=$!
+
+# Wait for the server.
+for ((i=0; i<50; i++)); do
+	(echo > /dev/tcp/127.0.0.1/${PORT}) 2> /dev/null && break
+	sleep 0.1
+done
+
+# Handshake counters from the pool page, prints "full resumed".
+counters() {
+	curl -s -H 'Accept: application/json' "${URL}/civetweb/pool" | python3 -c '
+import json, sys
+tls = json.load(sys.stdin)["tls"]
+print(int(tls["full-handshakes"]), int(tls["resumed-handshakes"]))
+' || fail "Cant get the pool counters"
+}
+
+read FULL_BEFORE RESUMED_BEFORE <<< $(counters)
+
+# The probes run on the async pool, wait for the pending response.
+LOCATION=$(curl -s -o /dev/null -D - "${URL}/probe/" | tr -d '\r' | grep -i '^Location:' | cut -d' ' -f2)
+[ -n "${LOCATION}" ] || fail "No pending response from ${URL}/probe/"
+
+case "${LOCATION}" in
+	http*)	;;
+	*)	LOCATION="${URL}${LOCATION}" ;;
+esac
+
+for ((i=0; i<60; i++)); do
+	STATUS=$(curl -s -H 'Accept: application/json' -o ${WORKDIR}/probes.json -w '%{http_code}' "${LOCATION}")
+	[ "${STATUS}" == "202" ] || break
+	sleep 1
+done
+
+[ "${STATUS}" == "200" ] || fail "Unexpected status '${STATUS}' from ${LOCATION}"
+
+read FULL_AFTER RESUMED_AFTER <<< $(counters)
+
+# Prints "count failures first-tls resumed-tls" (tls times in ms).
+read COUNT FAILED FIRST AVERAGE <<< $(python3 -c '
+import json, sys
+probes = json.load(open(sys.argv[1]))["probes"]
+probes = [probes[key] for key in sorted(probes, key=int)]
+failed = sum(1 for probe in probes if int(probe["rc"]) != 200)
+tls = [float(probe["tls"]) for probe in probes]
+rest = tls[1:]
+print(len(tls), failed, "%.3f" % tls[0], "%.3f" % (sum(rest) / len(rest) if rest else 0))
+' ${WORKDIR}/probes.json) || fail "Invalid probe response"
+
+FULL=$(( FULL_AFTER - FULL_BEFORE ))
+RESUMED=$(( RESUMED_AFTER - RESUMED_BEFORE ))
+
+echo "Probes: ${COUNT}, failed: ${FAILED}"
+echo "Handshakes: ${FULL} full, ${RESUMED} resumed"
+echo "timing.tls: first ${FIRST}ms, average of the others ${AVERAGE}ms"
+
+[ "${FAILED}" == "0" ] || fail "Some probes have failed"
+[ $(( FULL + RESUMED )) -ge ${COUNT} ] || fail "The probes didn't reach the server"
+[ ${RESUMED} -gt 0 ] || fail "No session was resumed, check [http-client] tls-resume"
+
+awk "BEGIN { printf \"Resumed handshake is %.2fx faster\\n\", ${FIRST} / (${AVERAGE} > 0 ? ${AVERAGE} : 1) }"